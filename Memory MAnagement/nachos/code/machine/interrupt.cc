@@ -60,10 +60,18 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    maxPending = 16;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    nextOrder = 0;
+    freePending = NULL;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
+    skippedChecks = 0;
+    nextDueTick = NeverDue;
+    sliceEnd = NeverDue;
+    lag = 0;
 }
 
 //----------------------------------------------------------------------
@@ -73,9 +81,16 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete pending->Remove();
-    delete pending;
+    PendingInterrupt *unused;
+
+    while (numPending > 0)
+	delete pending[--numPending];
+    delete [] pending;
+    while (freePending != NULL) {
+	unused = freePending;
+	freePending = unused->nextFree;
+	delete unused;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -146,6 +161,10 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	Most of the time nothing is due yet, which we can tell from
+//	"nextDueTick" alone.  When several CPUs are simulated, this is 
+//	also where the active one's turn ends.
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
@@ -154,14 +173,22 @@ Interrupt::OneTick()
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
+        Advance(SystemTick);
 	stats->systemTicks += SystemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
+	Advance(UserTick);
 	stats->userTicks += UserTick;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
+// if nothing can be due yet, the check below would only reorder the
+// pending list; leave that to CatchUpChecks, as FastUserTick does
+    if ((nextDueTick > stats->totalTicks) && !yieldOnReturn
+						&& !DebugIsEnabled('i')) {
+	skippedChecks++;
+	return;
+    }
+
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
@@ -175,7 +202,235 @@ Interrupt::OneTick()
  	status = SystemMode;		// yield is a kernel routine
 	currentThread->YieldCPU();
 	status = old;
+    } else if (stats->totalTicks >= sliceEnd) {	// this CPU's turn is over
+ 	status = SystemMode;
+	scheduler->EndSlice();
+	status = old;
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::FastUserTick
+// 	Advance simulated time by one user instruction, exactly as OneTick
+//	would, but without entering the interrupt machinery -- provided
+//	that no pending interrupt becomes due at the new time.
+//
+//	Each check that finds nothing due still takes the first pending
+//	interrupt off the queue and re-queues it behind its equal-time
+//	peers.  We only count those checks here; CatchUpChecks replays
+//	them before anybody next looks at the queue, so that interrupts
+//	fire in the same order as if every check had been made.
+//
+// Returns:
+//	FALSE, without advancing the time, if an interrupt would be due,
+//	or the active CPU is behind; the caller must then use OneTick.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::FastUserTick()
+{
+    if ((nextDueTick <= stats->totalTicks + UserTick) || (lag > 0))
+	return FALSE;
+    stats->totalTicks += UserTick;
+    stats->userTicks += UserTick;
+    skippedChecks++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CanFastTick, Interrupt::FastUserTicks
+// 	Advance simulated time by "count" user instructions at once,
+//	exactly as that many calls to FastUserTick would.  CanFastTick
+//	says whether they would all succeed; FastUserTicks must only be
+//	called if they would.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::CanFastTick(int count)
+{
+    return (nextDueTick > stats->totalTicks + count * UserTick) && (lag == 0);
+}
+
+void
+Interrupt::FastUserTicks(int count)
+{
+    ASSERT(CanFastTick(count));
+    stats->totalTicks += count * UserTick;
+    stats->userTicks += count * UserTick;
+    skippedChecks += count;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Advance
+// 	Run the active CPU's clock on by "ticks".  If it is behind the
+//	time (a CPU simulated after another one got further), it uses up
+//	that lag first; the time only moves on when the CPU gets past it.
+//	So the time never goes backwards, though the CPUs' clocks differ.
+//----------------------------------------------------------------------
+
+void
+Interrupt::Advance(int ticks)
+{
+    if (lag >= ticks) {
+	lag -= ticks;
+	return;
     }
+    stats->totalTicks += ticks - lag;
+    lag = 0;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CatchUpChecks
+// 	Apply the reordering of the pending queue that the elided checks
+//	would have done.  Each one re-queued the first interrupt behind 
+//	the others due at the same time, so only the number of checks
+//	modulo the number of such peers matters.
+//----------------------------------------------------------------------
+
+void
+Interrupt::CatchUpChecks()
+{
+    int rounds;
+
+    if ((skippedChecks > 0) && (numPending > 0)) {
+	rounds = skippedChecks % CountFirstPeers(0, pending[0]->when);
+	while (rounds-- > 0)
+	    InsertPending(RemovePending());
+    }
+    skippedChecks = 0;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::CountFirstPeers
+// 	Return how many interrupts in the part of the heap rooted at 
+//	"slot" are due at time "when", which must be the earliest time of
+//	any of them.  Since no entry is due before its parent, the search
+//	can stop at any entry due later.
+//----------------------------------------------------------------------
+
+int
+Interrupt::CountFirstPeers(int slot, int when)
+{
+    if ((slot >= numPending) || (pending[slot]->when != when))
+	return 0;
+    return 1 + CountFirstPeers(2 * slot + 1, when) 
+			+ CountFirstPeers(2 * slot + 2, when);
+}
+
+//----------------------------------------------------------------------
+// Earlier
+// 	Return TRUE if interrupt "a" should fire before interrupt "b".
+//----------------------------------------------------------------------
+
+static bool
+Earlier(PendingInterrupt *a, PendingInterrupt *b)
+{
+    return (a->when < b->when) || ((a->when == b->when) && (a->order < b->order));
+}
+
+//----------------------------------------------------------------------
+// Interrupt::InsertPending
+// 	Put an interrupt on the pending heap, behind any that are already
+//	there with the same "when" (so equal-time interrupts are FIFO,
+//	as they were when "pending" was a sorted list).
+//----------------------------------------------------------------------
+
+void
+Interrupt::InsertPending(PendingInterrupt *toOccur)
+{
+    PendingInterrupt **bigger;
+    int slot, parent;
+
+    if (numPending == maxPending) {	// out of room, double the array
+	bigger = new PendingInterrupt *[2 * maxPending];
+	for (slot = 0; slot < numPending; slot++)
+	    bigger[slot] = pending[slot];
+	delete [] pending;
+	pending = bigger;
+	maxPending *= 2;
+    }
+    toOccur->order = nextOrder++;
+    for (slot = numPending++; slot > 0; slot = parent) {	// sift up
+	parent = (slot - 1) / 2;
+	if (!Earlier(toOccur, pending[parent]))
+	    break;
+	pending[slot] = pending[parent];
+    }
+    pending[slot] = toOccur;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::RemovePending
+// 	Take the interrupt that is to fire first off the pending heap.
+//
+// Returns:
+//	The interrupt, or NULL if nothing is pending.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::RemovePending()
+{
+    PendingInterrupt *first, *moved;
+    int slot, child;
+
+    if (numPending == 0)
+	return NULL;
+    first = pending[0];
+    moved = pending[--numPending];
+    for (slot = 0; (child = 2 * slot + 1) < numPending; slot = child) {
+	if ((child + 1 < numPending) && Earlier(pending[child + 1], pending[child]))
+	    child++;			// sift down, toward the earlier child
+	if (!Earlier(pending[child], moved))
+	    break;
+	pending[slot] = pending[child];
+    }
+    if (numPending > 0)
+	pending[slot] = moved;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UpdateNextDue
+// 	Publish when the first pending interrupt is due (or the active
+//	CPU's turn ends, if that is sooner), so that OneTick and 
+//	FastUserTick can tell with a single comparison that there is
+//	nothing to do yet.  Must be called after every change to the set
+//	of pending interrupts.
+//----------------------------------------------------------------------
+
+void
+Interrupt::UpdateNextDue()
+{
+    if ((numPending > 0) && (pending[0]->when < sliceEnd))
+	nextDueTick = pending[0]->when;
+    else
+	nextDueTick = sliceEnd;		// nothing pending before then
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SetSliceEnd
+// 	Arrange for OneTick to call ProcessScheduler::EndSlice once the
+//	time reaches "when".  Used when simulating several CPUs.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SetSliceEnd(int when)
+{
+    sliceEnd = when;
+    UpdateNextDue();
+}
+
+//----------------------------------------------------------------------
+// Interrupt::SetLag
+// 	Note that the clock of the CPU about to be simulated is "ticks"
+//	behind the time; see Advance.  Used when simulating several CPUs.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SetLag(int ticks)
+{
+    ASSERT(ticks >= 0);
+    lag = ticks;
 }
 
 //----------------------------------------------------------------------
@@ -300,7 +555,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the pending heap, reusing an old
+//	PendingInterrupt if there is one.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -315,13 +571,24 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur = freePending;
+
+    if (toOccur != NULL) {
+	freePending = toOccur->nextFree;
+	toOccur->handler = handler;
+	toOccur->arg = arg;
+	toOccur->when = when;
+	toOccur->type = type;
+    } else
+	toOccur = new PendingInterrupt(handler, arg, when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    CatchUpChecks();
+    InsertPending(toOccur);
+    UpdateNextDue();
 }
 
 //----------------------------------------------------------------------
@@ -347,24 +614,28 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    CatchUpChecks();
+    PendingInterrupt *toOccur = RemovePending();
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
+    when = toOccur->when;
+    UpdateNextDue();
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
     } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+	InsertPending(toOccur);
+	UpdateNextDue();
 	return FALSE;
     }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& (numPending == 0)) {
+	 InsertPending(toOccur);
+	 UpdateNextDue();
 	 return FALSE;
     }
 
@@ -381,7 +652,8 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    toOccur->nextFree = freePending;		// keep it for reuse
+    freePending = toOccur;
     return TRUE;
 }
 
@@ -392,10 +664,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending(int arg)
+PrintPending(PendingInterrupt *pend)
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
-
     printf("Interrupt handler %s, scheduled at %d\n", 
 	intTypeNames[pend->type], pend->when);
 }
@@ -409,11 +679,26 @@ PrintPending(int arg)
 void
 Interrupt::DumpState()
 {
+    PendingInterrupt **sorted = new PendingInterrupt *[maxPending];
+    PendingInterrupt *swap;
+    int i, j;
+
     printf("Time: %d, interrupts %s\n", stats->totalTicks, 
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    CatchUpChecks();
+    for (i = 0; i < numPending; i++)	// in the order they will fire
+	sorted[i] = pending[i];
+    for (i = 1; i < numPending; i++)
+	for (j = i; (j > 0) && Earlier(sorted[j], sorted[j - 1]); j--) {
+	    swap = sorted[j];
+	    sorted[j] = sorted[j - 1];
+	    sorted[j - 1] = swap;
+	}
+    for (i = 0; i < numPending; i++)
+	PrintPending(sorted[i]);
+    delete [] sorted;
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -52,6 +52,9 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
 				NetworkSendInt, NetworkRecvInt};
 
+// "when" of an interrupt that will never happen
+#define NeverDue	0x7fffffff
+
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
 // left public to make it simpler to manipulate.
@@ -67,6 +70,10 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int order;			// When it was put on the pending queue;
+				// of two interrupts with the same "when",
+				// the one queued first fires first
+    PendingInterrupt *nextFree;	// Next entry in the pool of unused ones
 };
 
 // The following class defines the data structures for the simulation
@@ -111,20 +118,57 @@ class Interrupt {
     					// by the hardware device simulators.
     
     void OneTick();       		// Advance simulated time
+    bool FastUserTick();		// Advance simulated time by one user
+					// tick if no interrupt can be due;
+					// otherwise leave it to OneTick
+    bool CanFastTick(int count);	// Would FastUserTick succeed the
+					// next "count" times?
+    void FastUserTicks(int count);	// Do those "count" ticks at once
+    void SetSliceEnd(int when);		// Have OneTick call the scheduler
+					// at time "when" (SMP mode)
+    void SetLag(int ticks);		// The active CPU's clock is "ticks"
+					// behind totalTicks (SMP mode)
+    int Lag() { return lag; }
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// the interrupts scheduled to occur in
+				// the future, kept as a binary heap 
+				// ordered by "when", then "order"
+    int numPending;		// number of entries in "pending"
+    int maxPending;		// size of the "pending" array
+    int nextOrder;		// "order" to give the next entry queued
+    PendingInterrupt *freePending;	// entries no longer in use, kept
+				// to save a "new" for every interrupt
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
     MachineStatus status;	// idle, kernel mode, user mode
+    int skippedChecks;		// OneTick checks elided by FastUserTick,
+				// not yet applied to the "pending" order
+    int nextDueTick;		// "when" of the first pending interrupt,
+				// or sliceEnd if that is earlier
+    int sliceEnd;		// when the active CPU's turn ends, or
+				// NeverDue with only one CPU
+    int lag;			// how far the active CPU's clock is behind
+				// totalTicks; 0 with only one CPU
 
     // these functions are internal to the interrupt simulation code
 
+    void Advance(int ticks);		// Run the active CPU's clock on
     bool CheckIfDue(bool advanceClock); // Check if an interrupt is supposed
 					// to occur now
+    void CatchUpChecks();		// Reorder "pending" as the elided
+					// checks would have
+    void UpdateNextDue();		// Recompute "nextDueTick" after a
+					// change to "pending"
+    void InsertPending(PendingInterrupt *toOccur);
+					// Put an interrupt on the heap,
+					// behind any others with its "when"
+    PendingInterrupt *RemovePending();	// Take the first interrupt off
+    int CountFirstPeers(int slot, int when);
+					// Count the heap entries below
+					// "slot" due at time "when"
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
@@ -0,0 +1,288 @@
+// jit.cc
+//	Routines to lay out compiled user code as x86 host instructions.
+//	See jit.h for the overall design.
+//
+//	The accumulator is eax and the count register ecx; edx is
+//	scratch.  The simulated registers are addressed off ebx (rbx on
+//	a 64 bit host), which every function loads from its argument and
+//	restores on the way out.  Those instructions are the only ones
+//	that differ between 32 and 64 bit hosts.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "jit.h"
+#include "machine.h"
+
+// Host registers, as numbered in x86 instructions.
+
+#define EAX	0
+#define ECX	1
+#define EDX	2
+
+// Opcodes of "op eax, [ebx+disp32]", then of "op eax, imm32", by JitOp.
+
+static const int opWithRegister[] = { 0x03, 0x2b, 0x23, 0x0b, 0x33, 0x3b };
+static const int opWithImmediate[] = { 0x05, 0x2d, 0x25, 0x0d, 0x35, 0x3d };
+
+//----------------------------------------------------------------------
+// NewJitBuffer
+// 	Return an empty buffer for compiled code, or NULL if this host is
+//	not one we can compile for, or will not let us run code we write.
+//----------------------------------------------------------------------
+
+JitBuffer *
+NewJitBuffer()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    char *memory = AllocExecutable(JitBufferSize);
+
+    if (memory != NULL)
+	return new JitBuffer(memory, JitBufferSize);
+#endif
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::JitBuffer
+// 	Initialize an empty buffer of "size" bytes at "memory", which the
+//	host must let us both write and run.
+//----------------------------------------------------------------------
+
+JitBuffer::JitBuffer(char *mem, int bytes)
+{
+    memory = mem;
+    size = bytes;
+    used = 0;
+    generation = 0;
+}
+
+JitBuffer::~JitBuffer()
+{
+    DeallocExecutable(memory, size);
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Reserve
+// 	Make sure there is room for "bytes" more of code.  If there is
+//	not, throw away everything compiled so far, and start a new
+//	generation.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::Reserve(int bytes)
+{
+    ASSERT(bytes <= size);
+    if (used + bytes > size) {
+	DEBUG('m', "Compiled code buffer full, emptying it\n");
+	used = 0;
+	generation++;
+    }
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Byte, JitBuffer::Word
+// 	Add one byte, or a 32 bit little-endian word, of host code.  The
+//	caller has reserved room for it.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::Byte(int value)
+{
+    memory[used++] = (char) value;
+}
+
+void
+JitBuffer::Word(int value)
+{
+    Byte(value);
+    Byte(value >> 8);
+    Byte(value >> 16);
+    Byte(value >> 24);
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::RegisterOperand
+// 	Add an instruction "opcode" whose operands are host register
+//	"hostReg" and simulated register "reg", [ebx + 4*reg].
+//----------------------------------------------------------------------
+
+void
+JitBuffer::RegisterOperand(int opcode, int hostReg, int reg)
+{
+    Byte(opcode);
+    Byte(0x83 | (hostReg << 3));	// mod 10, base ebx, disp32
+    Word(reg * sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Start
+// 	Begin a function, and return it.  It saves ebx and points it at
+//	the registers it is passed.
+//----------------------------------------------------------------------
+
+JitFunction
+JitBuffer::Start()
+{
+    JitFunction function = (JitFunction) &memory[used];
+
+    Byte(0x53);				// push ebx
+#ifdef __x86_64__
+    Byte(0x48); Byte(0x89); Byte(0xfb);	// mov rbx, rdi
+#else
+    Byte(0x8b); Byte(0x5c); Byte(0x24); Byte(0x08);	// mov ebx, [esp+8]
+#endif
+    return function;
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Return
+// 	Return "value" from the function being compiled.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::Return(int value)
+{
+    Byte(0xb8); Word(value);		// mov eax, value
+    Byte(0x5b);				// pop ebx
+    Byte(0xc3);				// ret
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::JumpIfOverflow, JitBuffer::Bind
+// 	Add a jump taken if the last addition or subtraction overflowed,
+//	and later, point it at the code about to be compiled.  The jump
+//	is known by where its offset goes.
+//----------------------------------------------------------------------
+
+int
+JitBuffer::JumpIfOverflow()
+{
+    Byte(0x0f); Byte(0x80);		// jo rel32
+    Word(0);
+    return used - 4;
+}
+
+void
+JitBuffer::Bind(int jump)
+{
+    int offset = used - (jump + 4);
+    int save = used;
+
+    used = jump;
+    Word(offset);
+    used = save;
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Load, LoadCount, LoadImmediate, Store
+// 	Move values between the accumulator or count register and the
+//	simulated registers.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::Load(int reg)
+{
+    RegisterOperand(0x8b, EAX, reg);	// mov eax, reg
+}
+
+void
+JitBuffer::LoadCount(int reg)
+{
+    RegisterOperand(0x8b, ECX, reg);	// mov ecx, reg
+}
+
+void
+JitBuffer::LoadImmediate(int value)
+{
+    Byte(0xb8); Word(value);		// mov eax, value
+}
+
+void
+JitBuffer::Store(int reg)
+{
+    RegisterOperand(0x89, EAX, reg);	// mov reg, eax
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Arith, ArithImmediate, Not
+// 	Two's complement arithmetic on the accumulator, which is left
+//	alone by JitCompare.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::Arith(JitOp op, int reg)
+{
+    RegisterOperand(opWithRegister[op], EAX, reg);
+}
+
+void
+JitBuffer::ArithImmediate(JitOp op, int value)
+{
+    Byte(opWithImmediate[op]); Word(value);
+}
+
+void
+JitBuffer::Not()
+{
+    Byte(0xf7); Byte(0xd0);		// not eax
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::Shift, ShiftByCount
+// 	Shift the accumulator by "amount", or by the count register; the
+//	host uses only the low five bits of the count, as MIPS does.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::Shift(JitShift kind, int amount)
+{
+    Byte(0xc1);				// shl/sar eax, amount
+    Byte((kind == JitShiftLeft) ? 0xe0 : 0xf8);
+    Byte(amount);
+}
+
+void
+JitBuffer::ShiftByCount(JitShift kind)
+{
+    Byte(0xd3);				// shl/sar eax, cl
+    Byte((kind == JitShiftLeft) ? 0xe0 : 0xf8);
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::SetIf
+// 	Set the accumulator to 1 if the last JitCompare found it less
+//	than its operand, signed or unsigned, and to 0 otherwise.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::SetIf(JitCondition cond)
+{
+    Byte(0x0f);				// setl/setb al
+    Byte((cond == JitLess) ? 0x9c : 0x92);
+    Byte(0xc0);
+    Byte(0x0f); Byte(0xb6); Byte(0xc0);	// movzx eax, al
+}
+
+//----------------------------------------------------------------------
+// JitBuffer::DelayedLoad
+// 	Finish the delayed load started by the instruction before, if
+//	any, and leave none pending: the code for Machine::DelayedLoad
+//	when the instruction just done loads nothing.
+//----------------------------------------------------------------------
+
+void
+JitBuffer::DelayedLoad()
+{
+    Load(LoadReg);
+    RegisterOperand(0x8b, EDX, LoadValueReg);	// mov edx, LoadValueReg
+    Byte(0x89); Byte(0x14); Byte(0x83);	// mov [ebx + 4*eax], edx
+    LoadImmediate(0);
+    Store(LoadReg);
+    Store(LoadValueReg);
+    Store(0);
+}
@@ -0,0 +1,104 @@
+// jit.h
+//	Data structures for compiling hot user code to host instructions.
+//
+//	Once a basic block has run JitThreshold times (see mipssim.cc),
+//	each run of its instructions that only does register arithmetic
+//	is compiled to a host function, which works directly on
+//	Machine::registers.  Loads, stores, branches, multiplies and
+//	anything that can trap are still carried out by the simulator,
+//	between calls to the compiled pieces, so that every exception,
+//	delayed load and translation happens exactly as before.
+//
+//	A JitBuffer lays out the host instructions; only it knows the host
+//	instruction set.  It emits x86 code, for 32 or 64 bit hosts.  There
+//	is only a JitBuffer if -J asks for one; without it, on any other
+//	host, or if the host will not give us memory to run code from, all
+//	user code is interpreted.
+//
+//	Compiled code goes into one buffer.  When that is full it is all
+//	thrown away at once: the buffer's generation moves on, which tells
+//	the blocks that their code is gone, and they are compiled again
+//	as they run.  Compiled code never calls back into Nachos, so no
+//	thread can be in the middle of it when that happens.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define JitBufferSize	(4 * 1024 * 1024)	// bytes of host code
+#define JitInstrBytes	96		// most bytes one user instruction
+					// can need, with its share of the
+					// function around it
+
+// A compiled piece of user code.  It is passed Machine::registers, and
+// returns the index in its block of the first instruction it did not
+// carry out.
+
+typedef int (*JitFunction)(int *registers);
+
+// Arithmetic on the accumulator (see JitBuffer).
+
+enum JitOp { JitAdd, JitSub, JitAnd, JitOr, JitXor, JitCompare };
+enum JitShift { JitShiftLeft, JitShiftRightArith };
+enum JitCondition { JitLess, JitBelow };	// signed, unsigned
+
+// The following class defines the buffer of compiled code, and the
+// operations it can compile.  Code works on an accumulator, and on
+// a count register for variable shifts; "reg" is always a simulated
+// register, an index into Machine::registers.
+
+class JitBuffer {
+  public:
+    JitBuffer(char *memory, int size);	// An empty buffer in "memory"
+    ~JitBuffer();
+
+    int Generation() { return generation; }
+    void Reserve(int bytes);		// Make room for "bytes" more,
+					// throwing all the code away if
+					// need be
+
+    JitFunction Start();		// Begin a function
+    void Return(int value);		// Leave it, returning "value"
+    int JumpIfOverflow();		// Jump, if the last JitAdd or JitSub
+					// overflowed, to where Bind says
+    void Bind(int jump);		// The jump "jump" goes here
+
+    void Load(int reg);			// accumulator = reg
+    void LoadCount(int reg);		// count = reg
+    void LoadImmediate(int value);	// accumulator = value
+    void Store(int reg);		// reg = accumulator
+    void Arith(JitOp op, int reg);	// accumulator = accumulator op reg
+    void ArithImmediate(JitOp op, int value);
+    void Not();				// accumulator = ~accumulator
+    void Shift(JitShift kind, int amount);	// by a constant
+    void ShiftByCount(JitShift kind);	// by the count register
+    void SetIf(JitCondition cond);	// accumulator = 1 if the last
+					// JitCompare found it less, else 0
+    void DelayedLoad();			// Do the pending delayed load, as
+					// Machine::DelayedLoad(0, 0) does
+
+  private:
+    void Byte(int value);		// Add host code to the buffer
+    void Word(int value);
+    void RegisterOperand(int opcode, int hostReg, int reg);
+					// "opcode" with a ModRM operand
+					// naming simulated register "reg"
+
+    char *memory;			// The buffer
+    int size;				// How big it is
+    int used;				// How much holds code
+    int generation;			// Times it has been emptied
+};
+
+extern JitBuffer *NewJitBuffer();	// NULL if we cannot compile for
+					// this host
+
+#endif // JIT_H
@@ -50,9 +50,11 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"tlbEntries", "tlbAssoc" -- the size of the TLB, and of each of its
+//		sets; ignored unless the machine is built with a TLB
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, int tlbEntries, int tlbAssoc)
 {
     int i;
 
@@ -61,16 +63,32 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    InitBlockCache();
+    FlushTranslationCache();
 
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
+    // each set needs room for the two pages one instruction can touch
+    ASSERT((tlbAssoc > 1) && (tlbEntries % tlbAssoc == 0));
+    tlbSize = tlbEntries;
+    tlbWays = tlbAssoc;
+    tlb = new TranslationEntry[tlbSize];
+    tlbLastUse = new unsigned[tlbSize];
+    for (i = 0; i < tlbSize; i++) {
 	tlb[i].valid = FALSE;
+	tlbLastUse[i] = 0;
+    }
     KernelPageTable = NULL;
 #else	// use linear page table
+    tlbSize = tlbWays = 0;
     tlb = NULL;
+    tlbLastUse = NULL;
     KernelPageTable = NULL;
 #endif
+    tlbASID = 0;
+    tlbClock = 0;
+    invertedTable = NULL;
+    spaceId = 0;
+    tlbLastHit = -1;
 
     singleStep = debug;
     CheckEndian();
@@ -84,8 +102,12 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    DeleteBlockCache();
+    if (tlb != NULL) {
         delete [] tlb;
+	delete [] tlbLastUse;
+    }
+    delete invertedTable;
 }
 
 //----------------------------------------------------------------------
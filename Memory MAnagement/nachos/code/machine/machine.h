@@ -35,7 +35,10 @@
 //#define NumPhysPages   16 
 #define NumPhysPages    1024
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+#define TLBSize		4		// if there is a TLB, make it small,
+					// unless told otherwise (-TLB)
+#define TranslationCacheSize	64	// entries in the software cache
+					// of recent page table lookups
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -53,6 +56,18 @@ enum ExceptionType { NoException,           // Everything ok!
 		     NumExceptionTypes
 };
 
+// The following class defines an entry in the simulator's cache of
+// recent page table lookups: virtual page "virtualPage" of the current
+// address space is described by page table entry "entry".  This is not
+// part of the simulated hardware (so it is invisible to the kernel,
+// apart from the need to flush it when the page table is switched).
+
+class TranslationCacheEntry {
+  public:
+    unsigned int virtualPage;	// -1 if the slot is empty
+    TranslationEntry *entry;	// where that page is described
+};
+
 // User program CPU state.  The full set of MIPS registers, plus a few
 // more because we need to be able to start/stop a user program between
 // any two instructions (thus we need to keep track of things like load
@@ -92,6 +107,10 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+class BasicBlock;		// a decoded run of straight-line 
+				// instructions; see mipssim.cc
+class JitBuffer;		// compiled host code; see jit.h
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -107,7 +126,10 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, int tlbEntries, int tlbAssoc);	// Initialize the
+				// simulation of the hardware, with a TLB
+				// of "tlbEntries" in sets of "tlbAssoc"
+				// if it is built with one
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -124,6 +146,20 @@ class Machine {
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    void RunBlock();		// Run the basic block at the current pc
+    bool ExecuteBlock(BasicBlock *block, int frame, int codeEntry);
+				// Run one block; FALSE if it was cut short
+    bool StepBlock(BasicBlock *block, int i, int frame, int codeEntry);
+				// Simulate its instruction "i"
+    void RetireCompiled(int first, int next, int frame, int codeEntry);
+				// Account for instructions it ran compiled
+    void CompileBlock(BasicBlock *block);
+				// Compile its register arithmetic
+    BasicBlock *TranslateBlock(int physAddr);
+				// Find or decode the basic block starting
+				// at physical address "physAddr"
+    void InitBlockCache();	// Set up and tear down the pre-decoded
+    void DeleteBlockCache();	// instructions and the basic blocks
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -139,10 +175,34 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    void TLBHit(int entry);	// TLB entry "entry" served a translation
+    void NoteReference(int virtAddr, int physAddr, bool writing,
+			ExceptionType exception);
+				// Record a reference to "virtAddr", which
+				// Translate mapped to "physAddr" or failed
+				// with "exception", for the page
+				// replacement policies and the page trace
+
+    void FlushTranslationCache();
+				// Forget all cached page table lookups;
+				// must be called whenever "KernelPageTable"
+				// is changed to point somewhere else
 
     int GetPA (unsigned vaddr); // Returns the physical address corresponding
                                 // to the passed virtual address.
 
+    bool FetchInstruction(int addr, Instruction *instr);
+				// Fetch and decode the instruction at 
+				// virtual address "addr", using the 
+				// pre-decoded copy if there is one.
+				// Return FALSE if the translation failed.
+    Instruction *DecodedWord(int physAddr);
+				// The word at "physAddr", decoded, from the
+				// pre-decoded copy if it is still current
+    void InvalidateDecodedFrame(int frame);
+				// Forget the pre-decoded instructions of
+				// a physical page whose contents changed
+
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
@@ -162,6 +222,22 @@ class Machine {
  
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    Instruction *decodedInstrs;	// decoded form of each word of mainMemory,
+    int *decodedVersion;	// good only if decoded from the current
+				// version of its page (see frameVersion)
+
+    TranslationCacheEntry translationCache[TranslationCacheSize];
+				// recent page table lookups, indexed by
+				// virtual page number
+
+    BasicBlock **blocks;	// basic block starting at each word of
+				// mainMemory, if any
+    int *frameVersion;		// per physical page, bumped whenever the
+				// page contents change; decoded words and
+				// blocks from an older version are stale
+    JitBuffer *jit;		// host code compiled from hot blocks, with
+				// -J; NULL to simulate every instruction
+
 
 // NOTE: the hardware translation of virtual addresses in the user program
 // to physical addresses (relative to the beginning of "mainMemory")
@@ -169,8 +245,12 @@ class Machine {
 //	a traditional linear page table
 //  	a software-loaded translation lookaside buffer (tlb) -- a cache of 
 //	  mappings of virtual page #'s to physical page #'s
+//	a hashed inverted page table, with an entry per page in memory
 //
-// If "tlb" is NULL, the linear page table is used
+// If "tlb" is NULL, the linear page table is used, unless the kernel
+//	has installed an inverted page table; then that is, and the
+//	linear one only bounds the address space, and marks the pages
+//	that are not mapped
 // If "tlb" is non-NULL, the Nachos kernel is responsible for managing
 //	the contents of the TLB.  But the kernel can use any data structure
 //	it wants (eg, segmented paging) for handling TLB cache misses.
@@ -183,11 +263,28 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    int tlbSize;			// Entries in the TLB
+    int tlbWays;			// Entries in each set; page "vpn" goes
+					// in set vpn % (tlbSize / tlbWays)
+    int tlbASID;			// Address space identifier of the
+					// running process: only entries
+					// tagged with it are used
+    unsigned *tlbLastUse;		// When each entry was last used, for
+					// the kernel to replace the least
+					// recently used one
+
+    InvertedPageTable *invertedTable;	// if not NULL (and there is no
+					// TLB), translate through it (-IPT)
+    int spaceId;			// Process of the running address
+					// space, as the inverted page table
+					// names it
 
     TranslationEntry *KernelPageTable;
     unsigned int KernelPageTableSize;
 
   private:
+    unsigned tlbClock;		// TLB hits so far
+    int tlbLastHit;		// The entry of the last one
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
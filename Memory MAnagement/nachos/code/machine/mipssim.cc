@@ -4,6 +4,13 @@
 //   Byte ordering is little-endian, so we can be compatible with
 //   DEC RISC systems.
 //
+//   Each instruction is carried out by a handler routine, looked up 
+//   by op code.  Straight-line runs of user code are in addition
+//   pre-translated into basic blocks -- arrays of decoded instructions
+//   and their handlers -- which Run can execute back to back.  The
+//   register arithmetic of hot blocks can be compiled to host code
+//   (-J; see jit.h).
+//
 //   DO NOT CHANGE -- part of the machine emulation
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -14,15 +21,69 @@
 
 #include "machine.h"
 #include "mipssim.h"
+#include "jit.h"
 #include "system.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
+// The effects of an instruction that are only installed once it has
+// completed without an exception: the next program counter and the
+// delayed load it starts.
+
+struct PendingUpdate {
+    int pcAfter;		// new value of NextPCReg
+    int loadReg;		// register target of a delayed load
+    int loadValue;		// value to be loaded
+};
+
+// An instruction handler carries out one decoded instruction.  It 
+// returns FALSE if the instruction raised an exception.
+
+typedef bool (*InstrHandler)(Machine *m, Instruction *instr, 
+						PendingUpdate *update);
+
+static InstrHandler handlers[MaxOpcode + 1];
+
+// The following class defines a basic block: a run of instructions
+// starting at physical address "start", all in one page, executed
+// in sequence.  A block ends after a branch or jump and its delay slot,
+// after an instruction that always traps, or at the end of the page.
+// Its instructions are the pre-decoded words of memory FetchInstruction
+// uses too, so the two go stale together: when the version of the page
+// moves on from "version", the one it was translated from.
+//
+// Once a block is hot, each run of its instructions that IsCompiled is
+// compiled to a host function, "native" at the first of them.
+
+#define MaxBlockLength	(PageSize / 4)
+#define HotBlockThreshold	8	// runs before a block is chained
+#define JitThreshold	32	// runs before a block is compiled
+#define JitMinimumRun	2	// fewest instructions compiled together
+
+class BasicBlock {
+  public:
+    int start;			// physical address of first instruction
+    int version;		// frameVersion[] of the page when translated
+    int length;			// number of instructions
+    int runs;			// times run to completion
+    Instruction *instrs;	// the decoded instructions, in decodedInstrs
+    InstrHandler code[MaxBlockLength];	// and their handlers
+    int nativeGeneration;	// jit->Generation() when compiled, or -1
+    JitFunction native[MaxBlockLength];	// compiled code starting at each
+				// instruction, or NULL
+    int nativeEnd[MaxBlockLength];	// where that code stops
+};
+
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
 //	Called by the kernel when the program starts up; never returns.
 //
+//	Whenever the program is not in the middle of a branch delay slot,
+//	we run a whole basic block at a time.  When single-stepping or
+//	tracing we go back to one instruction at a time, so that the
+//	debugger and the traces see every instruction.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //----------------------------------------------------------------------
@@ -31,15 +92,23 @@ void
 Machine::Run()
 {
     Instruction *instr = new Instruction;  // storage for decoded instruction
+    bool tracing = DebugIsEnabled('m') || DebugIsEnabled('a') || 
+						DebugIsEnabled('i');
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
+	if (!singleStep && !tracing &&
+		(registers[NextPCReg] == registers[PCReg] + 4)) {
+	    RunBlock();
+	    continue;
+	}
         currentThread->IncInstructionCount();
         OneInstruction(instr);
-	interrupt->OneTick();
+	if (tracing || !interrupt->FastUserTick())
+	    interrupt->OneTick();
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
@@ -68,6 +137,715 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// Instruction handlers
+// 	One routine per op code (cf. Kane's book).  Each one updates the
+//	registers and memory of "m" for the instruction "instr", and
+//	leaves the next pc and any delayed load in "update".
+//
+//	Returns FALSE if an exception was raised, in which case the
+//	caller must not install "update".
+//----------------------------------------------------------------------
+
+static bool
+DoADD(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int sum = registers[instr->rs] + registers[instr->rt];
+
+    if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ sum) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rd] = sum;
+    return TRUE;
+}
+
+static bool
+DoADDI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int sum = registers[instr->rs] + instr->extra;
+
+    if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rt] = sum;
+    return TRUE;
+}
+
+static bool
+DoADDIU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] + instr->extra;
+    return TRUE;
+}
+
+static bool
+DoADDU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] + m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+DoAND(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] & m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+DoANDI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] & (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+DoBEQ(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] == m->registers[instr->rt])
+	update->pcAfter = m->registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoBGEZ(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (!(m->registers[instr->rs] & SIGN_BIT))
+	update->pcAfter = m->registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoBGEZAL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return DoBGEZ(m, instr, update);
+}
+
+static bool
+DoBGTZ(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] > 0)
+	update->pcAfter = m->registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoBLEZ(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] <= 0)
+	update->pcAfter = m->registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoBLTZ(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] & SIGN_BIT)
+	update->pcAfter = m->registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoBLTZAL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return DoBLTZ(m, instr, update);
+}
+
+static bool
+DoBNE(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] != m->registers[instr->rt])
+	update->pcAfter = m->registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoDIV(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rt] == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
+	registers[HiReg] = registers[instr->rs] % registers[instr->rt];
+    }
+    return TRUE;
+}
+
+static bool
+DoDIVU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    unsigned int rs = (unsigned int) registers[instr->rs];
+    unsigned int rt = (unsigned int) registers[instr->rt];
+    int tmp;
+
+    if (rt == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	tmp = rs / rt;
+	registers[LoReg] = (int) tmp;
+	tmp = rs % rt;
+	registers[HiReg] = (int) tmp;
+    }
+    return TRUE;
+}
+
+static bool
+DoJ(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    update->pcAfter = (update->pcAfter & 0xf0000000) | 
+					IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+DoJAL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return DoJ(m, instr, update);
+}
+
+static bool
+DoJR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    update->pcAfter = m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+DoJALR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[NextPCReg] + 4;
+    return DoJR(m, instr, update);
+}
+
+static bool
+DoLB(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int tmp = m->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (!m->ReadMem(tmp, 1, &value))
+	return FALSE;
+
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    update->loadReg = instr->rt;
+    update->loadValue = value;
+    return TRUE;
+}
+
+static bool
+DoLH(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int tmp = m->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (tmp & 0x1) {
+	m->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!m->ReadMem(tmp, 2, &value))
+	return FALSE;
+
+    if ((value & 0x8000) && (instr->opCode == OP_LH))
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    update->loadReg = instr->rt;
+    update->loadValue = value;
+    return TRUE;
+}
+
+static bool
+DoLUI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+    m->registers[instr->rt] = instr->extra << 16;
+    return TRUE;
+}
+
+static bool
+DoLW(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int tmp = m->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (tmp & 0x3) {
+	m->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    update->loadReg = instr->rt;
+    update->loadValue = value;
+    return TRUE;
+}
+
+static bool
+DoLWL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value, nextLoadValue;
+
+    // ReadMem assumes all 4 byte requests are aligned on an even 
+    // word boundary.  Also, the little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);  
+
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    if (registers[LoadReg] == instr->rt)
+	nextLoadValue = registers[LoadValueReg];
+    else
+	nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	nextLoadValue = value;
+	break;
+      case 1:
+	nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
+	break;
+      case 2:
+	nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
+	break;
+      case 3:
+	nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
+	break;
+    }
+    update->loadReg = instr->rt;
+    update->loadValue = nextLoadValue;
+    return TRUE;
+}
+
+static bool
+DoLWR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value, nextLoadValue;
+
+    // ReadMem assumes all 4 byte requests are aligned on an even 
+    // word boundary.  Also, the little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);  
+
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    if (registers[LoadReg] == instr->rt)
+	nextLoadValue = registers[LoadValueReg];
+    else
+	nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	nextLoadValue = (nextLoadValue & 0xffffff00) |
+	    ((value >> 24) & 0xff);
+	break;
+      case 1:
+	nextLoadValue = (nextLoadValue & 0xffff0000) |
+	    ((value >> 16) & 0xffff);
+	break;
+      case 2:
+	nextLoadValue = (nextLoadValue & 0xff000000)
+	    | ((value >> 8) & 0xffffff);
+	break;
+      case 3:
+	nextLoadValue = value;
+	break;
+    }
+    update->loadReg = instr->rt;
+    update->loadValue = nextLoadValue;
+    return TRUE;
+}
+
+static bool
+DoMFHI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[HiReg];
+    return TRUE;
+}
+
+static bool
+DoMFLO(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[LoReg];
+    return TRUE;
+}
+
+static bool
+DoMTHI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[HiReg] = m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+DoMTLO(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[LoReg] = m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+DoMULT(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    Mult(m->registers[instr->rs], m->registers[instr->rt], TRUE,
+	 &m->registers[HiReg], &m->registers[LoReg]);
+    return TRUE;
+}
+
+static bool
+DoMULTU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    Mult(m->registers[instr->rs], m->registers[instr->rt], FALSE,
+	 &m->registers[HiReg], &m->registers[LoReg]);
+    return TRUE;
+}
+
+static bool
+DoNOR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = ~(m->registers[instr->rs] | m->registers[instr->rt]);
+    return TRUE;
+}
+
+static bool
+DoOR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] | m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+DoORI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] | (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+DoSB(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    return m->WriteMem((unsigned) 
+	(m->registers[instr->rs] + instr->extra), 1, m->registers[instr->rt]);
+}
+
+static bool
+DoSH(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    return m->WriteMem((unsigned) 
+	(m->registers[instr->rs] + instr->extra), 2, m->registers[instr->rt]);
+}
+
+static bool
+DoSLL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] << instr->extra;
+    return TRUE;
+}
+
+static bool
+DoSLLV(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] <<
+	(m->registers[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+static bool
+DoSLT(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] < m->registers[instr->rt])
+	m->registers[instr->rd] = 1;
+    else
+	m->registers[instr->rd] = 0;
+    return TRUE;
+}
+
+static bool
+DoSLTI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    if (m->registers[instr->rs] < instr->extra)
+	m->registers[instr->rt] = 1;
+    else
+	m->registers[instr->rt] = 0;
+    return TRUE;
+}
+
+static bool
+DoSLTIU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    unsigned int rs = m->registers[instr->rs];
+    unsigned int imm = instr->extra;
+
+    if (rs < imm)
+	m->registers[instr->rt] = 1;
+    else
+	m->registers[instr->rt] = 0;
+    return TRUE;
+}
+
+static bool
+DoSLTU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    unsigned int rs = m->registers[instr->rs];
+    unsigned int rt = m->registers[instr->rt];
+
+    if (rs < rt)
+	m->registers[instr->rd] = 1;
+    else
+	m->registers[instr->rd] = 0;
+    return TRUE;
+}
+
+static bool
+DoSRA(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] >> instr->extra;
+    return TRUE;
+}
+
+static bool
+DoSRAV(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] >>
+	(m->registers[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+static bool
+DoSRL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int tmp = m->registers[instr->rt];
+
+    tmp >>= instr->extra;
+    m->registers[instr->rd] = tmp;
+    return TRUE;
+}
+
+static bool
+DoSRLV(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int tmp = m->registers[instr->rt];
+
+    tmp >>= (m->registers[instr->rs] & 0x1f);
+    m->registers[instr->rd] = tmp;
+    return TRUE;
+}
+
+static bool
+DoSUB(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int diff = registers[instr->rs] - registers[instr->rt];
+
+    if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ diff) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rd] = diff;
+    return TRUE;
+}
+
+static bool
+DoSUBU(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] - m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+DoSW(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    return m->WriteMem((unsigned) 
+	(m->registers[instr->rs] + instr->extra), 4, m->registers[instr->rt]);
+}
+
+static bool
+DoSWL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value;
+
+    // The little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);  
+
+    if (!m->ReadMem((tmp & ~0x3), 4, &value))
+	return FALSE;
+    switch (tmp & 0x3) {
+      case 0:
+	value = registers[instr->rt];
+	break;
+      case 1:
+	value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
+					0xffffff);
+	break;
+      case 2:
+	value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
+					0xffff);
+	break;
+      case 3:
+	value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
+					0xff);
+	break;
+    }
+    return m->WriteMem((tmp & ~0x3), 4, value);
+}
+
+static bool
+DoSWR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value;
+
+    // The little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);  
+
+    if (!m->ReadMem((tmp & ~0x3), 4, &value))
+	return FALSE;
+    switch (tmp & 0x3) {
+      case 0:
+	value = (value & 0xffffff) | (registers[instr->rt] << 24);
+	break;
+      case 1:
+	value = (value & 0xffff) | (registers[instr->rt] << 16);
+	break;
+      case 2:
+	value = (value & 0xff) | (registers[instr->rt] << 8);
+	break;
+      case 3:
+	value = registers[instr->rt];
+	break;
+    }
+    return m->WriteMem((tmp & ~0x3), 4, value);
+}
+
+static bool
+DoSYSCALL(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->RaiseException(SyscallException, 0);
+    return FALSE;
+}
+
+static bool
+DoXOR(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] ^ m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+DoXORI(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] ^ (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+DoIllegal(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    m->RaiseException(IllegalInstrException, 0);
+    return FALSE;
+}
+
+static bool
+DoBadOpCode(Machine *m, Instruction *instr, PendingUpdate *update)
+{
+    ASSERT(FALSE);
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// InitInstrHandlers
+// 	Fill in the table of instruction handlers, indexed by op code.
+//----------------------------------------------------------------------
+
+static void
+InitInstrHandlers()
+{
+    for (int i = 0; i <= MaxOpcode; i++)
+	handlers[i] = DoBadOpCode;
+    handlers[OP_ADD] = DoADD;
+    handlers[OP_ADDI] = DoADDI;
+    handlers[OP_ADDIU] = DoADDIU;
+    handlers[OP_ADDU] = DoADDU;
+    handlers[OP_AND] = DoAND;
+    handlers[OP_ANDI] = DoANDI;
+    handlers[OP_BEQ] = DoBEQ;
+    handlers[OP_BGEZ] = DoBGEZ;
+    handlers[OP_BGEZAL] = DoBGEZAL;
+    handlers[OP_BGTZ] = DoBGTZ;
+    handlers[OP_BLEZ] = DoBLEZ;
+    handlers[OP_BLTZ] = DoBLTZ;
+    handlers[OP_BLTZAL] = DoBLTZAL;
+    handlers[OP_BNE] = DoBNE;
+    handlers[OP_DIV] = DoDIV;
+    handlers[OP_DIVU] = DoDIVU;
+    handlers[OP_J] = DoJ;
+    handlers[OP_JAL] = DoJAL;
+    handlers[OP_JALR] = DoJALR;
+    handlers[OP_JR] = DoJR;
+    handlers[OP_LB] = DoLB;
+    handlers[OP_LBU] = DoLB;
+    handlers[OP_LH] = DoLH;
+    handlers[OP_LHU] = DoLH;
+    handlers[OP_LUI] = DoLUI;
+    handlers[OP_LW] = DoLW;
+    handlers[OP_LWL] = DoLWL;
+    handlers[OP_LWR] = DoLWR;
+    handlers[OP_MFHI] = DoMFHI;
+    handlers[OP_MFLO] = DoMFLO;
+    handlers[OP_MTHI] = DoMTHI;
+    handlers[OP_MTLO] = DoMTLO;
+    handlers[OP_MULT] = DoMULT;
+    handlers[OP_MULTU] = DoMULTU;
+    handlers[OP_NOR] = DoNOR;
+    handlers[OP_OR] = DoOR;
+    handlers[OP_ORI] = DoORI;
+    handlers[OP_SB] = DoSB;
+    handlers[OP_SH] = DoSH;
+    handlers[OP_SLL] = DoSLL;
+    handlers[OP_SLLV] = DoSLLV;
+    handlers[OP_SLT] = DoSLT;
+    handlers[OP_SLTI] = DoSLTI;
+    handlers[OP_SLTIU] = DoSLTIU;
+    handlers[OP_SLTU] = DoSLTU;
+    handlers[OP_SRA] = DoSRA;
+    handlers[OP_SRAV] = DoSRAV;
+    handlers[OP_SRL] = DoSRL;
+    handlers[OP_SRLV] = DoSRLV;
+    handlers[OP_SUB] = DoSUB;
+    handlers[OP_SUBU] = DoSUBU;
+    handlers[OP_SW] = DoSW;
+    handlers[OP_SWL] = DoSWL;
+    handlers[OP_SWR] = DoSWR;
+    handlers[OP_SYSCALL] = DoSYSCALL;
+    handlers[OP_XOR] = DoXOR;
+    handlers[OP_XORI] = DoXORI;
+    handlers[OP_RES] = DoIllegal;
+    handlers[OP_UNIMP] = DoIllegal;
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -94,16 +872,12 @@ TypeToReg(RegType reg, Instruction *instr)
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
+    PendingUpdate update;	// record delayed load operation, to apply
 				// in the future
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    if (!machine->FetchInstruction(registers[PCReg], instr))
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -116,453 +890,548 @@ Machine::OneInstruction(Instruction *instr)
        }
     
     // Compute next pc, but don't install in case there's an error or branch.
-    int pcAfter = registers[NextPCReg] + 4;
-    int sum, diff, tmp, value;
-    unsigned int rs, rt, imm;
+    update.pcAfter = registers[NextPCReg] + 4;
+    update.loadReg = 0;
+    update.loadValue = 0;
 
-    // Execute the instruction (cf. Kane's book)
-    switch (instr->opCode) {
-	
-      case OP_ADD:
-	sum = registers[instr->rs] + registers[instr->rt];
-	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = sum;
-	break;
-	
-      case OP_ADDI:
-	sum = registers[instr->rs] + instr->extra;
-	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
-	    ((instr->extra ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
+    // Execute the instruction
+    ASSERT(instr->opCode <= MaxOpcode);
+    if (!(*handlers[(int) instr->opCode])(this, instr, &update))
+	return;			// exception occurred
+    
+    // Now we have successfully executed the instruction.
+    
+    // Do any delayed load operation
+    DelayedLoad(update.loadReg, update.loadValue);
+    
+    // Advance program counters.
+    registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
+						// are jumping into lala-land
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = update.pcAfter;
+}
+
+//----------------------------------------------------------------------
+// HasDelaySlot
+// 	Return TRUE if "opCode" is a branch or a jump, i.e. is followed
+//	by a delay slot.
+//----------------------------------------------------------------------
+
+static bool
+HasDelaySlot(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// AlwaysTraps
+// 	Return TRUE if the instruction "opCode" always traps to the kernel.
+//----------------------------------------------------------------------
+
+static bool
+AlwaysTraps(int opCode)
+{
+    return (handlers[opCode] == DoSYSCALL) || (handlers[opCode] == DoIllegal)
+		|| (handlers[opCode] == DoBadOpCode);
+}
+
+//----------------------------------------------------------------------
+// Machine::InitBlockCache
+// 	Set up the instruction handler table, empty tables of pre-decoded
+//	instructions and basic blocks.  There is no buffer for compiled
+//	code until -J asks for one.  Called when the machine is created.
+//----------------------------------------------------------------------
+
+void
+Machine::InitBlockCache()
+{
+    int i;
+
+    InitInstrHandlers();
+    jit = NULL;			// see -J
+    decodedInstrs = new Instruction[MemorySize / 4];
+    decodedVersion = new int[MemorySize / 4];
+    blocks = new BasicBlock*[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+	decodedVersion[i] = -1;		// older than any page
+	blocks[i] = NULL;
+    }
+    frameVersion = new int[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+	frameVersion[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// Machine::DeleteBlockCache
+// 	De-allocate the pre-decoded instructions, the basic blocks and
+//	their compiled code.
+//----------------------------------------------------------------------
+
+void
+Machine::DeleteBlockCache()
+{
+    for (int i = 0; i < MemorySize / 4; i++)
+	delete blocks[i];
+    delete [] blocks;
+    delete jit;
+    delete [] decodedInstrs;
+    delete [] decodedVersion;
+    delete [] frameVersion;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodedWord
+// 	Return the word of memory at physical address "physAddr", decoded.
+//	The decoded copy is kept, and used again until the contents of
+//	the page change.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodedWord(int physAddr)
+{
+    int word = physAddr / 4, version = frameVersion[physAddr / PageSize];
+
+    if (decodedVersion[word] != version) {
+	decodedInstrs[word].value = 
+		WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+	decodedInstrs[word].Decode();
+	decodedVersion[word] = version;
+    }
+    return &decodedInstrs[word];
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateBlock
+// 	Return the basic block starting at physical address "physAddr",
+//	decoding it first if we have no copy that is still current.
+//----------------------------------------------------------------------
+
+BasicBlock *
+Machine::TranslateBlock(int physAddr)
+{
+    int frame = physAddr / PageSize;
+    int pageEnd = (frame + 1) * PageSize;
+    BasicBlock *block = blocks[physAddr / 4];
+    Instruction *instr;
+    int addr;
+
+    if ((block != NULL) && (block->version == frameVersion[frame]))
+	return block;
+    if (block == NULL) {
+	block = new BasicBlock;
+	blocks[physAddr / 4] = block;
+    }
+    block->start = physAddr;
+    block->version = frameVersion[frame];
+    block->length = 0;
+    block->runs = 0;
+    block->nativeGeneration = -1;
+    block->instrs = &decodedInstrs[physAddr / 4];
+    for (addr = physAddr; addr < pageEnd; addr += 4) {
+	instr = DecodedWord(addr);
+	block->code[block->length++] = handlers[(int) instr->opCode];
+	if (AlwaysTraps(instr->opCode))
+	    break;
+	if (HasDelaySlot(instr->opCode)) {
+	    // take the delay slot too, if it is in the same page
+	    if (addr + 4 < pageEnd) {
+		instr = DecodedWord(addr + 4);
+		block->code[block->length++] = handlers[(int) instr->opCode];
+	    }
+	    break;
+	}
+    }
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Execute the basic block starting at the current pc, which must
+//	not be in a branch delay slot.
+//
+//	Every instruction has exactly the effect it would have under
+//	OneInstruction, and time advances one tick per instruction as
+//	before; but rather than calling OneTick after every instruction,
+//	we only do so when an interrupt is due (or after an exception),
+//	and then end the block, so that interrupts still happen on
+//	exactly the same tick.  The block also ends early if one of its
+//	own stores changed the page it was decoded from.
+//
+//	Once a block has run HotBlockThreshold times, it is chained:
+//	when it finishes cleanly and control stays in the same page, 
+//	we go straight on to the next block here, without another
+//	trip through Run and Translate.  Nothing can remap the page
+//	without an exception or an interrupt, and either one ends the
+//	chain, so the frame found by the first Translate is still good.
+//	So is its TLB entry, which each chained fetch hits.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlock()
+{
+    int physAddr, frame, pc, codeEntry;
+    unsigned vpn;
+    BasicBlock *block;
+    Instruction instr;
+
+    if (Translate(registers[PCReg], &physAddr, 4, FALSE) != NoException) {
+	currentThread->IncInstructionCount();
+	OneInstruction(&instr);		// let it raise the exception
+	interrupt->OneTick();
+	return;
+    }
+    frame = physAddr / PageSize;
+    vpn = (unsigned) registers[PCReg] / PageSize;
+    codeEntry = tlbLastHit;		// the TLB entry of the page, if any
+    block = TranslateBlock(physAddr);
+    while (ExecuteBlock(block, frame, codeEntry)) {
+	if (++block->runs < HotBlockThreshold)
 	    return;
+	pc = registers[PCReg];
+	if ((registers[NextPCReg] != pc + 4) || (pc & 0x3) 
+				|| ((unsigned) pc / PageSize != vpn))
+	    return;			// let Run and Translate handle it
+	block = TranslateBlock(frame * PageSize + (unsigned) pc % PageSize);
+	if (tlb != NULL)		// its first fetch skipped Translate
+	    TLBHit(codeEntry);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteBlock
+// 	Run the instructions of "block", which was decoded from physical
+//	page "frame", and which the TLB entry "codeEntry" maps (if there
+//	is a TLB).  Return TRUE if the whole block ran with no 
+//	exception, no interrupt due, and no change to its own page.
+//
+//	Once the block is hot it is compiled, and its compiled runs of
+//	instructions are used whenever no interrupt can fall due during
+//	one; the instructions around them are simulated as before.
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteBlock(BasicBlock *block, int frame, int codeEntry)
+{
+    bool compiled;
+    int i, next;
+
+    if ((jit != NULL) && (block->runs >= JitThreshold)
+			&& (block->nativeGeneration != jit->Generation()))
+	CompileBlock(block);
+    compiled = (jit != NULL) && (block->nativeGeneration == jit->Generation());
+    for (i = 0; i < block->length; i++) {
+	if (compiled && (block->native[i] != NULL) 
+			&& interrupt->CanFastTick(block->nativeEnd[i] - i)) {
+	    next = (*block->native[i])(registers);
+	    RetireCompiled(i, next, frame, codeEntry);
+	    if (next == block->length)
+		break;
+	    i = next;		// not compiled, or it overflowed
 	}
-	registers[instr->rt] = sum;
+	if (!StepBlock(block, i, frame, codeEntry))
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::StepBlock
+// 	Simulate instruction "i" of "block" (see ExecuteBlock).  Return
+//	FALSE if the block must end here.
+//
+//	The fetches after the first skip Translate, but each is still a
+//	real hit on "codeEntry", so that LRU replacement in the TLB sees
+//	the code page used as often as it is.  Its use bit was set by the
+//	Translate that found the page, and only the kernel clears it.
+//----------------------------------------------------------------------
+
+bool
+Machine::StepBlock(BasicBlock *block, int i, int frame, int codeEntry)
+{
+    PendingUpdate update;
+
+    currentThread->IncInstructionCount();
+    if ((tlb != NULL) && (i > 0))
+	TLBHit(codeEntry);		// a fetch the TLB would serve
+    NoteReference(registers[PCReg], frame * PageSize, FALSE, NoException);
+
+    update.pcAfter = registers[NextPCReg] + 4;
+    update.loadReg = 0;
+    update.loadValue = 0;
+    if (!(*block->code[i])(this, &block->instrs[i], &update)) {
+	interrupt->OneTick();
+	return FALSE;			// exception occurred
+    }
+    DelayedLoad(update.loadReg, update.loadValue);
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = update.pcAfter;
+
+    if (!interrupt->FastUserTick()) {
+	interrupt->OneTick();
+	return FALSE;
+    }
+    return (frameVersion[frame] == block->version);
+					// else the block wrote to its own page
+}
+
+//----------------------------------------------------------------------
+// Machine::RetireCompiled
+// 	Account for instructions "first" to "next" - 1 of a block, just
+//	run as host code, as StepBlock would have: count them, advance
+//	the pc and the time past them, and note their fetches.
+//
+//	They are fetched from one page, one after the other, and with no
+//	other memory reference in between, so all but the first fetch
+//	leave the page replacement state as it was: one NoteReference
+//	stands for them all.
+//----------------------------------------------------------------------
+
+void
+Machine::RetireCompiled(int first, int next, int frame, int codeEntry)
+{
+    int i;
+
+    if (next == first)
+	return;				// the first one overflowed
+    currentThread->AddInstructionCount(next - first);
+    if (tlb != NULL)
+	for (i = first; i < next; i++)
+	    if (i > 0)
+		TLBHit(codeEntry);
+    NoteReference(registers[PCReg], frame * PageSize, FALSE, NoException);
+    for (i = first; i < next; i++) {
+	registers[PrevPCReg] = registers[PCReg];
+	registers[PCReg] = registers[NextPCReg];
+	registers[NextPCReg] += 4;
+    }
+    interrupt->FastUserTicks(next - first);
+}
+
+//----------------------------------------------------------------------
+// IsCompiled
+// 	Return TRUE if the instruction "opCode" is compiled to host code:
+//	it does arithmetic on the registers, and nothing else, except
+//	perhaps trap on an overflow.
+//----------------------------------------------------------------------
+
+static bool
+IsCompiled(int opCode)
+{
+    switch (opCode) {
+      case OP_ADD: case OP_ADDI: case OP_ADDIU: case OP_ADDU:
+      case OP_AND: case OP_ANDI: case OP_LUI: case OP_MFHI: case OP_MFLO:
+      case OP_MTHI: case OP_MTLO: case OP_NOR: case OP_OR: case OP_ORI:
+      case OP_SLL: case OP_SLLV: case OP_SLT: case OP_SLTI: case OP_SLTIU:
+      case OP_SLTU: case OP_SRA: case OP_SRAV: case OP_SRL: case OP_SRLV:
+      case OP_SUB: case OP_SUBU: case OP_XOR: case OP_XORI:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// EmitInstruction
+// 	Compile "instr", which IsCompiled, to do exactly what its handler
+//	does.  Return the jump taken if it overflows, in which case it
+//	has changed nothing, or -1 if it cannot overflow.
+//----------------------------------------------------------------------
+
+static int
+EmitInstruction(JitBuffer *jit, Instruction *instr)
+{
+    int rs = instr->rs, rt = instr->rt, imm = instr->extra;
+    int dest = instr->rd;
+    int overflow = -1;
+
+    switch (instr->opCode) {
+      case OP_ADD:
+	jit->Load(rs);
+	jit->Arith(JitAdd, rt);
+	overflow = jit->JumpIfOverflow();
+	break;
+      case OP_ADDI:
+	jit->Load(rs);
+	jit->ArithImmediate(JitAdd, imm);
+	overflow = jit->JumpIfOverflow();
+	dest = rt;
 	break;
-	
       case OP_ADDIU:
-	registers[instr->rt] = registers[instr->rs] + instr->extra;
+	jit->Load(rs);
+	jit->ArithImmediate(JitAdd, imm);
+	dest = rt;
 	break;
-	
       case OP_ADDU:
-	registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
+	jit->Load(rs);
+	jit->Arith(JitAdd, rt);
 	break;
-	
       case OP_AND:
-	registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
+	jit->Load(rs);
+	jit->Arith(JitAnd, rt);
 	break;
-	
       case OP_ANDI:
-	registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
-	break;
-	
-      case OP_BEQ:
-	if (registers[instr->rs] == registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGEZAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BGEZ:
-	if (!(registers[instr->rs] & SIGN_BIT))
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+	jit->Load(rs);
+	jit->ArithImmediate(JitAnd, imm & 0xffff);
+	dest = rt;
 	break;
-	
-      case OP_BGTZ:
-	if (registers[instr->rs] > 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLEZ:
-	if (registers[instr->rs] <= 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLTZAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BLTZ:
-	if (registers[instr->rs] & SIGN_BIT)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BNE:
-	if (registers[instr->rs] != registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_DIV:
-	if (registers[instr->rt] == 0) {
-	    registers[LoReg] = 0;
-	    registers[HiReg] = 0;
-	} else {
-	    registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
-	    registers[HiReg] = registers[instr->rs] % registers[instr->rt];
-	}
-	break;
-	
-      case OP_DIVU:	  
-	  rs = (unsigned int) registers[instr->rs];
-	  rt = (unsigned int) registers[instr->rt];
-	  if (rt == 0) {
-	      registers[LoReg] = 0;
-	      registers[HiReg] = 0;
-	  } else {
-	      tmp = rs / rt;
-	      registers[LoReg] = (int) tmp;
-	      tmp = rs % rt;
-	      registers[HiReg] = (int) tmp;
-	  }
-	  break;
-	
-      case OP_JAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_J:
-	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
-	break;
-	
-      case OP_JALR:
-	registers[instr->rd] = registers[NextPCReg] + 4;
-      case OP_JR:
-	pcAfter = registers[instr->rs];
-	break;
-	
-      case OP_LB:
-      case OP_LBU:
-	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
-
-	if ((value & 0x80) && (instr->opCode == OP_LB))
-	    value |= 0xffffff00;
-	else
-	    value &= 0xff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-	
-      case OP_LH:
-      case OP_LHU:	  
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x1) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
-
-	if ((value & 0x8000) && (instr->opCode == OP_LH))
-	    value |= 0xffff0000;
-	else
-	    value &= 0xffff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-      	
       case OP_LUI:
-	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
-	registers[instr->rt] = instr->extra << 16;
-	break;
-	
-      case OP_LW:
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x3) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-    	
-      case OP_LWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = value;
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
-	    break;
-	  case 3:
-	    nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-      	
-      case OP_LWR:
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = (nextLoadValue & 0xffffff00) |
-		((value >> 24) & 0xff);
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xffff0000) |
-		((value >> 16) & 0xffff);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xff000000)
-		| ((value >> 8) & 0xffffff);
-	    break;
-	  case 3:
-	    nextLoadValue = value;
-	    break;
-	}
-	nextLoadReg = instr->rt;
+	jit->LoadImmediate(imm << 16);
+	dest = rt;
 	break;
-    	
       case OP_MFHI:
-	registers[instr->rd] = registers[HiReg];
+	jit->Load(HiReg);
 	break;
-	
       case OP_MFLO:
-	registers[instr->rd] = registers[LoReg];
+	jit->Load(LoReg);
 	break;
-	
       case OP_MTHI:
-	registers[HiReg] = registers[instr->rs];
+	jit->Load(rs);
+	dest = HiReg;
 	break;
-	
       case OP_MTLO:
-	registers[LoReg] = registers[instr->rs];
-	break;
-	
-      case OP_MULT:
-	Mult(registers[instr->rs], registers[instr->rt], TRUE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_MULTU:
-	Mult(registers[instr->rs], registers[instr->rt], FALSE,
-	     &registers[HiReg], &registers[LoReg]);
+	jit->Load(rs);
+	dest = LoReg;
 	break;
-	
       case OP_NOR:
-	registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
+	jit->Load(rs);
+	jit->Arith(JitOr, rt);
+	jit->Not();
 	break;
-	
       case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+	jit->Load(rs);		// rs | rs, as DoOR has it
 	break;
-	
       case OP_ORI:
-	registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
-	break;
-	
-      case OP_SB:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	jit->Load(rs);
+	jit->ArithImmediate(JitOr, imm & 0xffff);
+	dest = rt;
 	break;
-	
-      case OP_SH:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
-	break;
-	
       case OP_SLL:
-	registers[instr->rd] = registers[instr->rt] << instr->extra;
+	jit->Load(rt);
+	jit->Shift(JitShiftLeft, imm);
 	break;
-	
       case OP_SLLV:
-	registers[instr->rd] = registers[instr->rt] <<
-	    (registers[instr->rs] & 0x1f);
+	jit->LoadCount(rs);
+	jit->Load(rt);
+	jit->ShiftByCount(JitShiftLeft);
 	break;
-	
       case OP_SLT:
-	if (registers[instr->rs] < registers[instr->rt])
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
+	jit->Load(rs);
+	jit->Arith(JitCompare, rt);
+	jit->SetIf(JitLess);
 	break;
-	
       case OP_SLTI:
-	if (registers[instr->rs] < instr->extra)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
+	jit->Load(rs);
+	jit->ArithImmediate(JitCompare, imm);
+	jit->SetIf(JitLess);
+	dest = rt;
 	break;
-	
-      case OP_SLTIU:	  
-	rs = registers[instr->rs];
-	imm = instr->extra;
-	if (rs < imm)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-      	
-      case OP_SLTU:	  
-	rs = registers[instr->rs];
-	rt = registers[instr->rt];
-	if (rs < rt)
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-      	
-      case OP_SRA:
-	registers[instr->rd] = registers[instr->rt] >> instr->extra;
+      case OP_SLTIU:
+	jit->Load(rs);
+	jit->ArithImmediate(JitCompare, imm);
+	jit->SetIf(JitBelow);
+	dest = rt;
 	break;
-	
-      case OP_SRAV:
-	registers[instr->rd] = registers[instr->rt] >>
-	    (registers[instr->rs] & 0x1f);
+      case OP_SLTU:
+	jit->Load(rs);
+	jit->Arith(JitCompare, rt);
+	jit->SetIf(JitBelow);
 	break;
-	
-      case OP_SRL:
-	tmp = registers[instr->rt];
-	tmp >>= instr->extra;
-	registers[instr->rd] = tmp;
+      case OP_SRA:
+      case OP_SRL:		// DoSRL shifts a signed value too
+	jit->Load(rt);
+	jit->Shift(JitShiftRightArith, imm);
 	break;
-	
+      case OP_SRAV:
       case OP_SRLV:
-	tmp = registers[instr->rt];
-	tmp >>= (registers[instr->rs] & 0x1f);
-	registers[instr->rd] = tmp;
+	jit->LoadCount(rs);
+	jit->Load(rt);
+	jit->ShiftByCount(JitShiftRightArith);
 	break;
-	
-      case OP_SUB:	  
-	diff = registers[instr->rs] - registers[instr->rt];
-	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = diff;
+      case OP_SUB:
+	jit->Load(rs);
+	jit->Arith(JitSub, rt);
+	overflow = jit->JumpIfOverflow();
 	break;
-      	
       case OP_SUBU:
-	registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
-	break;
-	
-      case OP_SW:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	jit->Load(rs);
+	jit->Arith(JitSub, rt);
 	break;
-	
-      case OP_SWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = registers[instr->rt];
-	    break;
-	  case 1:
-	    value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
-					    0xffffff);
-	    break;
-	  case 2:
-	    value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
-					    0xffff);
-	    break;
-	  case 3:
-	    value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
-					    0xff);
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SWR:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
-	    break;
-	  case 1:
-	    value = (value & 0xffff) | (registers[instr->rt] << 16);
-	    break;
-	  case 2:
-	    value = (value & 0xff) | (registers[instr->rt] << 8);
-	    break;
-	  case 3:
-	    value = registers[instr->rt];
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SYSCALL:
-	RaiseException(SyscallException, 0);
-	return; 
-	
       case OP_XOR:
-	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
+	jit->Load(rs);
+	jit->Arith(JitXor, rt);
 	break;
-	
       case OP_XORI:
-	registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
+	jit->Load(rs);
+	jit->ArithImmediate(JitXor, imm & 0xffff);
+	dest = rt;
 	break;
-	
-      case OP_RES:
-      case OP_UNIMP:
-	RaiseException(IllegalInstrException, 0);
-	return;
-	
       default:
 	ASSERT(FALSE);
     }
-    
-    // Now we have successfully executed the instruction.
-    
-    // Do any delayed load operation
-    DelayedLoad(nextLoadReg, nextLoadValue);
-    
-    // Advance program counters.
-    registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
-						// are jumping into lala-land
-    registers[PCReg] = registers[NextPCReg];
-    registers[NextPCReg] = pcAfter;
+    if (dest != 0)		// r0 stays zero
+	jit->Store(dest);
+    return overflow;
+}
+
+//----------------------------------------------------------------------
+// Machine::CompileBlock
+// 	Compile each run of instructions of "block" that IsCompiled to a
+//	host function, unless it is shorter than JitMinimumRun: calling
+//	the host code for one instruction costs about what simulating it
+//	does.  The function returns the index of the instruction after
+//	the run, or of an instruction in it that overflowed, for
+//	StepBlock to simulate, raising the exception.
+//
+//	Only the first instruction of a run can follow a load whose
+//	delayed load is still pending, as the instruction before it, if
+//	any, was simulated; the runs never load anything themselves.
+//----------------------------------------------------------------------
+
+void
+Machine::CompileBlock(BasicBlock *block)
+{
+    int overflow[MaxBlockLength], overflowAt[MaxBlockLength];
+    int i, start, end, jump, numOverflows;
+
+    jit->Reserve(block->length * JitInstrBytes);
+    block->nativeGeneration = jit->Generation();
+    for (i = 0; i < block->length; i++)
+	block->native[i] = NULL;
+    for (i = 0; i < block->length; ) {
+	for (end = i; (end < block->length) 
+			&& IsCompiled(block->instrs[end].opCode); end++)
+	    ;
+	if (end - i < JitMinimumRun) {
+	    i = end + 1;		// not worth a call
+	    continue;
+	}
+	start = i;
+	block->native[start] = jit->Start();
+	numOverflows = 0;
+	for (; i < end; i++) {
+	    jump = EmitInstruction(jit, &block->instrs[i]);
+	    if (jump >= 0) {
+		overflow[numOverflows] = jump;
+		overflowAt[numOverflows++] = i;
+	    }
+	    if (i == start)
+		jit->DelayedLoad();
+	}
+	block->nativeEnd[start] = i;
+	jit->Return(i);
+	for (jump = 0; jump < numOverflows; jump++) {
+	    jit->Bind(overflow[jump]);
+	    jit->Return(overflowAt[jump]);
+	}
+    }
 }
 
 //----------------------------------------------------------------------
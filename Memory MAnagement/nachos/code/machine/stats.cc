@@ -22,6 +22,18 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numCopyOnWrites = numSharedText = 0;
+    numPrefetches = numPrefetchHits = numPrefetchWasted = 0;
+    numPagesTrimmed = numSuspensions = numQuotaReplacements = 0;
+    numDirtyEvictions = numPagesCleaned = numSharedEvictions = 0;
+    numFrameAllocations = numFrameCacheHits = numFramesExamined = 0;
+    numTLBHits = numTLBMisses = numTLBFlushes = 0;
+    numIPTLookups = numIPTProbes = 0;
+    numSleeps = numWakeups = maxSleepQueueDepth = 0;
+    totalWakeupLateness = maxWakeupLateness = 0;
+    numCPUs = 1;
+    for (int i = 0; i < MAX_CPU_COUNT; i++)
+	cpuBusyTicks[i] = cpuMigrations[i] = 0;
     
     total_wait_time = 0;
     cpu_time = 0;
@@ -50,9 +62,44 @@ Statistics::Print()
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d, copy-on-write %d, shared code %d\n", 
+	numPageFaults, numCopyOnWrites, numSharedText);
+    if (numPrefetches > 0)
+	printf("Prefetch: pages %d, used %d, wasted %d\n", numPrefetches,
+	    numPrefetchHits, numPrefetchWasted);
+    if ((numPagesTrimmed > 0) || (numSuspensions > 0)
+	    || (numQuotaReplacements > 0))
+	printf("Resident sets: pages trimmed %d, suspensions %d, "
+	    "own pages replaced %d\n", numPagesTrimmed, numSuspensions,
+	    numQuotaReplacements);
+    if (numPagesCleaned > 0)
+	printf("Page cleaner: pages cleaned %d, dirty evictions %d\n",
+	    numPagesCleaned, numDirtyEvictions);
+    if (numSharedEvictions > 0)
+	printf("Shared memory: pages evicted %d\n", numSharedEvictions);
+    if (numFrameAllocations > 0)
+	printf("Frames: allocations %d, from CPU caches %d, "
+	    "examined per allocation %.2f\n", numFrameAllocations,
+	    numFrameCacheHits, (float)numFramesExamined/numFrameAllocations);
+    if (numTLBHits + numTLBMisses > 0)
+	printf("TLB: hits %d, misses %d, hit rate %.2f%%, flushes %d\n",
+	    numTLBHits, numTLBMisses,
+	    100.0 * numTLBHits / (numTLBHits + numTLBMisses), numTLBFlushes);
+    if (numIPTLookups > 0)
+	printf("Inverted page table: lookups %d, probes per lookup %.2f\n",
+	    numIPTLookups, (float)numIPTProbes/numIPTLookups);
+    printf("Sleep queue: sleeps %d, max depth %d, wakeups %d, "
+	"lateness max %d, mean %.2f\n", numSleeps, maxSleepQueueDepth, 
+	numWakeups, maxWakeupLateness, 
+	numWakeups ? (float)totalWakeupLateness/numWakeups : 0.0);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    if (numCPUs > 1) {
+	for (int i = 0; i < numCPUs; i++)
+	    printf("CPU %d: busy %d, utilisation %.2f%%, migrations %d\n", i,
+		cpuBusyTicks[i], totalTicks ? 
+		(100.0*cpuBusyTicks[i])/totalTicks : 0.0, cpuMigrations[i]);
+    }
 
     printf("\nTotal simulated ticks: %d\n", totalTicks - start_time);
     printf("Total CPU busy time: %d\n", cpu_time);
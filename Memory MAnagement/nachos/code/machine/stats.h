@@ -13,6 +13,8 @@
 
 #include "copyright.h"
 
+#define MAX_CPU_COUNT	16	// most CPUs that can be simulated (-N)
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -47,8 +49,56 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numCopyOnWrites;	// number of pages copied on a write after
+				// being shared by fork
+    int numSharedText;		// number of code pages mapped from
+				// another process running the same program
+    int numPrefetches;		// number of pages brought in ahead of a
+				// fault on them
+    int numPrefetchHits;	// number of those referenced before they
+				// were replaced or freed
+    int numPrefetchWasted;	// number of those that were not; pages
+				// still in memory at the end are neither
+    int numPagesTrimmed;	// number of pages taken from processes
+				// whose working set shrank
+    int numSuspensions;		// number of times load control swapped
+				// a process out
+    int numQuotaReplacements;	// number of pages a process at its
+				// quota gave up for one it faulted on
+    int numDirtyEvictions;	// number of pages written to swap when
+				// they were replaced
+    int numPagesCleaned;	// number of pages the page cleaner wrote
+				// back ahead of their replacement
+    int numSharedEvictions;	// number of pages of shared memory
+				// replaced, from every process at once
+    int numFrameAllocations;	// number of frames handed out, free or
+				// replaced
+    int numFrameCacheHits;	// number of those a CPU had kept (-FC)
+    int numFramesExamined;	// number of frames looked at to hand
+				// them out, free or as candidates to
+				// replace
+    int numTLBHits;		// number of translations the TLB served
+    int numTLBMisses;		// number of translations it had to be
+				// refilled for (or that page faulted)
+    int numTLBFlushes;		// number of times the TLB was emptied
+				// because the ASIDs ran out
+    int numIPTLookups;		// number of translations looked up in
+				// the inverted page table
+    int numIPTProbes;		// number of its entries looked at
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numSleeps;		// number of times a thread was put on
+				// the sleep queue
+    int numWakeups;		// number of sleeping threads woken up
+    int maxSleepQueueDepth;	// most threads ever asleep at once
+    int totalWakeupLateness;	// sum, over all wakeups, of the ticks
+    int maxWakeupLateness;	// between when the thread was due and
+				// when it was woken
+    int numCPUs;		// number of simulated CPUs
+    int cpuBusyTicks[MAX_CPU_COUNT];	// time each CPU spent running
+				// a thread
+    int cpuMigrations[MAX_CPU_COUNT];	// threads each CPU took over
+				// from another one
 
     Statistics(); 		// initialize everything to zero
 
@@ -492,3 +492,34 @@ DeallocBoundedArray(char *ptr, int size)
     mprotect(ptr + size, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
     delete [] (ptr - pgSize);
 }
+
+//----------------------------------------------------------------------
+// AllocExecutable
+// 	Return memory that we may both write to and run as code, or NULL
+//	if the host will not give us any.
+//
+//	"size" -- amount of space needed (in bytes)
+//----------------------------------------------------------------------
+
+char *
+AllocExecutable(int size)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return (ptr == MAP_FAILED) ? NULL : (char *) ptr;
+}
+
+//----------------------------------------------------------------------
+// DeallocExecutable
+// 	Give back memory from AllocExecutable.
+//
+//	"ptr" -- the memory to be deallocated
+//	"size" -- how much of it there is (in bytes)
+//----------------------------------------------------------------------
+
+void
+DeallocExecutable(char *ptr, int size)
+{
+    munmap(ptr, size);
+}
@@ -55,6 +55,11 @@ extern int Random();
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(char *p, int size);
 
+// Allocate, de-allocate memory the host can run code from, for
+// compiled user code; NULL if the host will not give us any
+extern char *AllocExecutable(int size);
+extern void DeallocExecutable(char *p, int size);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
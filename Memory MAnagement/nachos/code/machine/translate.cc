@@ -20,6 +20,10 @@
 //	(such as page tables), but the hardware doesn't need to know
 //	anything at all about that.
 //
+//	Hashed inverted page table -- one entry per physical frame, found
+//	by hashing the process and the virtual page #.  If the page is
+//	not there, it traps to software, like a TLB miss (-IPT).
+//
 //	Note that the contents of the TLB are specific to an address space.
 //	If the address space changes, so does the contents of the TLB!
 //
@@ -33,6 +37,8 @@
 #include "machine.h"
 #include "addrspace.h"
 #include "system.h"
+#include "pagepolicy.h"
+#include "pagetrace.h"
 #include "noff.h"
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -94,6 +100,7 @@ Machine::ReadMem(int addr, int size, int *value)
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
+    NoteReference(addr, physicalAddress, FALSE, exception);
     if (exception != NoException) {
 	machine->RaiseException(exception, addr);
 	return FALSE;
@@ -118,8 +125,6 @@ Machine::ReadMem(int addr, int size, int *value)
     }
     
     DEBUG('a', "\tvalue read = %8.8x\n", *value);
-    Count_ArrLRU[physicalAddress/PageSize] = stats->totalTicks;
-    ArrCLRU_s[physicalAddress/PageSize] = 1;
     return (TRUE);
 }
 
@@ -144,6 +149,7 @@ Machine::WriteMem(int addr, int size, int value)
    // KernelPageTable[addr/PageSize].dirty = TRUE     
     DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
     exception = Translate(addr, &physicalAddress, size, TRUE);
+    NoteReference(addr, physicalAddress, TRUE, exception);
     if (exception != NoException) {
 	machine->RaiseException(exception, addr);
 	return FALSE;
@@ -165,12 +171,107 @@ Machine::WriteMem(int addr, int size, int value)
 	
       default: ASSERT(FALSE);
     }
-    KernelPageTable[addr/PageSize].dirty = TRUE;
-     Count_ArrLRU[physicalAddress/PageSize] = stats->totalTicks;
-     ArrCLRU_s[physicalAddress/PageSize] = 1;
+    frameVersion[physicalAddress/PageSize]++;	// the page may hold code
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+//      Fetch the instruction at virtual address "addr" into "instr", 
+//	decoded.  The translation and the page bookkeeping are exactly
+//	those of ReadMem; only the decoding is skipped when the word has
+//	already been decoded since its physical page last changed.
+//
+//   	Returns FALSE if the translation step from virtual to physical memory
+//   	failed.
+//
+//	"addr" -- the virtual address of the instruction
+//	"instr" -- the place to store the decoded instruction
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(int addr, Instruction *instr)
+{
+    ExceptionType exception;
+    int physicalAddress;
+
+    DEBUG('a', "Fetching VA 0x%x\n", addr);
+
+    exception = Translate(addr, &physicalAddress, 4, FALSE);
+    NoteReference(addr, physicalAddress, FALSE, exception);
+    if (exception != NoException) {
+	machine->RaiseException(exception, addr);
+	return FALSE;
+    }
+    *instr = *DecodedWord(physicalAddress);
+
+    DEBUG('a', "\tinstruction read = %8.8x\n", instr->value);
+    return (TRUE);
+}
+
+//----------------------------------------------------------------------
+// Machine::TLBHit
+//      Note that TLB entry "entry" served a translation: count the hit,
+//	and make the entry the most recently used one, for the kernel's
+//	LRU replacement.  The entry's use and dirty bits are the
+//	kernel's business, and are set by Translate.
+//----------------------------------------------------------------------
+
+void
+Machine::TLBHit(int entry)
+{
+    stats->numTLBHits++;
+    tlbLastUse[entry] = ++tlbClock;
+    tlbLastHit = entry;
+}
+
+//----------------------------------------------------------------------
+// Machine::NoteReference
+//      Do the bookkeeping of a reference by the user program to virtual
+//	address "virtAddr": record it in the page trace, unless it was an
+//	address error, and, if it was translated to "physAddr" without an
+//	exception, set the use bits the page replacement policies read
+//	at the next fault.  Every load, store and instruction fetch comes
+//	here, from ReadMem, WriteMem and FetchInstruction, or from
+//	ExecuteBlock for the fetches of a basic block.
+//
+//	"writing" -- if TRUE, the reference was a store
+//	"exception" -- what Translate returned for it
+//----------------------------------------------------------------------
+
+void
+Machine::NoteReference(int virtAddr, int physAddr, bool writing,
+			ExceptionType exception)
+{
+    int frame;
+
+    if ((pageTrace != NULL) && (exception != AddressErrorException))
+	pageTrace->Reference(currentThread->GetPID(),
+			     (unsigned) virtAddr / PageSize, writing);
+    if (exception != NoException)
+	return;
+    frame = physAddr / PageSize;
+    lruFrames->Touch(frame);
+    ArrCLRU_s[frame] = 1;
+    if (pagePolicy != NULL)
+	pagePolicy->Reference(frame);
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodedFrame
+//      Discard the pre-decoded instructions, and so the basic blocks, of
+//	physical page "frame", by moving on its version.
+//	Must be called whenever the kernel refills or hands out a frame,
+//	since those writes do not go through WriteMem.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodedFrame(int frame)
+{
+    ASSERT((frame >= 0) && (frame < NumPhysPages));
+    frameVersion[frame]++;
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -194,6 +295,25 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     TranslationEntry *entry;
     unsigned int pageFrame;
 
+    TranslationCacheEntry *cached;
+
+    // first, the fast path: a properly aligned access to a page we have 
+    // looked up before.  The page table entry may have changed since, 
+    // so we still have to check it, but most of the work is skipped.
+    vpn = (unsigned) virtAddr / PageSize;
+    cached = &translationCache[vpn % TranslationCacheSize];
+    if ((cached->virtualPage == vpn) && !(virtAddr & (size - 1))) {
+	entry = cached->entry;
+	if (entry->valid && !(writing && entry->readOnly)) {
+	    entry->use = TRUE;
+	    if (writing)
+		entry->dirty = TRUE;
+	    *physAddr = entry->physicalPage * PageSize + 
+					(unsigned) virtAddr % PageSize;
+	    return NoException;
+	}
+    }
+
     DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
 // check for alignment errors
@@ -202,8 +322,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	return AddressErrorException;
     }
     
-    // we must have either a TLB or a page table, but not both!
-    ASSERT(tlb == NULL || KernelPageTable == NULL);	
+    // with a TLB, the page table is only for the kernel to refill it
+    // from, and to keep the use and dirty bits in
     ASSERT(tlb != NULL || KernelPageTable != NULL);	
 
 // calculate the virtual page number, and offset within the page,
@@ -215,15 +335,29 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	    DEBUG('a', "virtual page # %d too large for page table size %d!\n", 
 			virtAddr, KernelPageTableSize);
 	    return AddressErrorException;
+	} else if (KernelPageTable[vpn].unmapped) {
+	    DEBUG('a', "virtual page # %d is not mapped!\n", vpn);
+	    return AddressErrorException;
+	} else if (invertedTable != NULL) {	// => hash it instead
+	    stats->numIPTLookups++;
+	    entry = invertedTable->Lookup(spaceId, vpn);
+	    if (entry == NULL) {
+		DEBUG('a', "*** virtual page # %d not in inverted page table!\n",
+			vpn);
+		return PageFaultException;	// not in memory
+	    }
 	} else if (!KernelPageTable[vpn].valid) {
 		DEBUG('a', "2nd case : virtual page # %d too large for page table size %d!\n",
                         virtAddr, KernelPageTableSize);
                 return PageFaultException;
-	}
-	entry = &KernelPageTable[vpn];
-    } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
+	} else
+	    entry = &KernelPageTable[vpn];
+    } else {			// => look in the set "vpn" maps to
+	int first = (vpn % (tlbSize / tlbWays)) * tlbWays;
+
+        for (entry = NULL, i = first; i < first + tlbWays; i++)
+    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)
+				&& (tlb[i].asid == tlbASID)) {
 		entry = &tlb[i];			// FOUND!
 		break;
 	    }
@@ -233,6 +367,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	TLBHit(i);
     }
     
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -250,17 +385,46 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
 	entry->dirty = TRUE;
+    if (tlb != NULL) {			// and write them through
+						// to the page table
+	KernelPageTable[vpn].use = TRUE;
+	if (writing)
+	    KernelPageTable[vpn].dirty = TRUE;
+    }
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+
+    // remember the lookup, unless it has to be traced every time
+    if ((tlb == NULL) && (invertedTable == NULL) && !DebugIsEnabled('a')) {
+	cached->virtualPage = vpn;
+	cached->entry = entry;
+    }
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// Machine::FlushTranslationCache
+// 	Empty the cache of page table lookups used by Translate.  Since
+//	the cache holds pointers into the current page table, this must
+//	be done whenever the kernel points the machine at another table.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslationCache()
+{
+    for (int i = 0; i < TranslationCacheSize; i++) {
+	translationCache[i].virtualPage = (unsigned) -1;
+	translationCache[i].entry = NULL;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::GetPA
 //      Returns the physical address corresponding to the passed virtual
 //      address. Error conditions to check: virtual page number (vpn) is
-//      bigger than the page table size and the page table entry is not valid.
+//      bigger than the page table size and the page table entry is not valid
+//      (under -IPT: the page is not in the inverted page table).
 //      In case of error, returns -1.
 //----------------------------------------------------------------------
 
@@ -272,11 +436,148 @@ Machine::GetPA (unsigned vaddr)
    TranslationEntry *entry;
    unsigned int pageFrame;
 
-   if ((vpn < KernelPageTableSize) && KernelPageTable[vpn].valid) {
+   if (invertedTable != NULL)
+      entry = invertedTable->Find(spaceId, vpn);
+   else if ((vpn < KernelPageTableSize) && KernelPageTable[vpn].valid)
       entry = &KernelPageTable[vpn];
+   else
+      entry = NULL;
+   if (entry != NULL) {
       pageFrame = entry->physicalPage;
       if (pageFrame >= NumPhysPages) return -1;
       return pageFrame * PageSize + offset;
    }
    else return -1;
 }
+
+//----------------------------------------------------------------------
+// InvertedPageTable::InvertedPageTable
+// 	Initialize an empty table, with a hash bucket for each frame.
+//----------------------------------------------------------------------
+
+InvertedPageTable::InvertedPageTable(int frames)
+{
+    numBuckets = frames;
+    bucket = new InvertedEntry *[numBuckets];
+    for (int i = 0; i < numBuckets; i++)
+	bucket[i] = NULL;
+    freeEntries = NULL;
+}
+
+InvertedPageTable::~InvertedPageTable()
+{
+    InvertedEntry *entry;
+
+    for (int i = 0; i < numBuckets; i++)
+	while (bucket[i] != NULL) {
+	    entry = bucket[i];
+	    bucket[i] = entry->next;
+	    delete entry;
+	}
+    while (freeEntries != NULL) {
+	entry = freeEntries;
+	freeEntries = entry->next;
+	delete entry;
+    }
+    delete [] bucket;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Lookup
+// 	Return the translation of page "vpn" of process "pid", or NULL if
+//	the page is not in the table.  Called by Translate; each entry
+//	looked at is counted.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+InvertedPageTable::Lookup(int pid, int vpn)
+{
+    InvertedEntry *entry;
+
+    for (entry = bucket[Bucket(pid, vpn)]; entry != NULL; entry = entry->next) {
+	stats->numIPTProbes++;
+	if ((entry->translation.virtualPage == vpn)
+			&& (entry->translation.asid == pid))
+	    return &entry->translation;
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Find
+// 	Return the translation of page "vpn" of process "pid", or NULL if
+//	the page is not in the table, for the kernel.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+InvertedPageTable::Find(int pid, int vpn)
+{
+    InvertedEntry **link = Link(pid, vpn);
+
+    return (*link != NULL) ? &(*link)->translation : NULL;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Insert
+// 	Enter page "vpn" of process "pid", which is now in "frame", and
+//	return its translation.  It must not be in the table already.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+InvertedPageTable::Insert(int pid, int vpn, int frame)
+{
+    InvertedEntry **link = Link(pid, vpn), *entry;
+
+    ASSERT(*link == NULL);
+    if (freeEntries != NULL) {
+	entry = freeEntries;
+	freeEntries = entry->next;
+    } else
+	entry = new InvertedEntry;
+    entry->translation.virtualPage = vpn;
+    entry->translation.physicalPage = frame;
+    entry->translation.valid = TRUE;
+    entry->translation.readOnly = FALSE;
+    entry->translation.use = FALSE;
+    entry->translation.dirty = FALSE;
+    entry->translation.asid = pid;
+    entry->next = bucket[Bucket(pid, vpn)];
+    bucket[Bucket(pid, vpn)] = entry;
+    return &entry->translation;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Remove
+// 	Drop the translation of page "vpn" of process "pid", which must
+//	be in the table.
+//----------------------------------------------------------------------
+
+void
+InvertedPageTable::Remove(int pid, int vpn)
+{
+    InvertedEntry **link = Link(pid, vpn), *entry = *link;
+
+    ASSERT(entry != NULL);
+    *link = entry->next;
+    entry->translation.valid = FALSE;
+    entry->next = freeEntries;
+    freeEntries = entry;
+}
+
+//----------------------------------------------------------------------
+// InvertedPageTable::Link
+// 	Return what points to the entry of page "vpn" of process "pid":
+//	the head of its bucket, or the entry before it in the chain.  If
+//	it is not in the table, that is the NULL at the end of the chain.
+//----------------------------------------------------------------------
+
+InvertedEntry **
+InvertedPageTable::Link(int pid, int vpn)
+{
+    InvertedEntry **link = &bucket[Bucket(pid, vpn)];
+
+    while ((*link != NULL) && (((*link)->translation.virtualPage != vpn)
+			|| ((*link)->translation.asid != pid)))
+	link = &(*link)->next;
+    return link;
+}
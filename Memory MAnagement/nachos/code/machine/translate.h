@@ -41,7 +41,64 @@ class TranslationEntry {
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
     bool shared;        //added to know if page is shared
-    bool backup;
+    bool backup;	// The page has been saved to the swap area, in
+    int swapSlot;	// this slot; load it from there, not the executable
+    bool copyOnWrite;   // The frame is shared with forked processes until
+			// one of them writes to it (readOnly is set too)
+    bool prefetched;	// The page was brought in ahead of a fault, and
+			// has not been accounted for in the statistics yet
+    bool unmapped;	// Nothing is mapped at the page (a segment was
+			// detached from it): using it is an address error
+    int asid;		// In the TLB, the address space the entry
+			// belongs to; in the inverted page table, the
+			// process
+};
+
+// The following class defines a hashed inverted page table: the
+// translation of each page that is in memory.  An entry is found by
+// hashing the process and the virtual page number, and following the
+// chain of entries in that bucket, so the table grows with the pages
+// in memory, however large the address spaces are.
+//
+// It is the only record of which pages are in memory, and where: the
+// kernel enters a page when it gives it a frame, and takes it out when
+// the frame is taken away, and the page table of each process only
+// says where its pages are kept when they are not in memory.  A frame
+// shared between processes has an entry for each of them.
+
+class InvertedEntry {
+  public:
+    TranslationEntry translation;	// Its asid is the process
+    InvertedEntry *next;		// The next entry in the same bucket,
+					// or the next unused one
+};
+
+class InvertedPageTable {
+  public:
+    InvertedPageTable(int numFrames);	// An empty table, for memory of
+					// "numFrames" frames
+    ~InvertedPageTable();
+
+    TranslationEntry *Lookup(int pid, int vpn);	// Translation of page
+					// "vpn" of "pid"; NULL if it is not
+					// in memory
+    TranslationEntry *Find(int pid, int vpn);	// The same, for the
+					// kernel: not counted as probes
+    TranslationEntry *Insert(int pid, int vpn, int frame);	// Page "vpn"
+					// of "pid" is now in "frame"; returns
+					// its translation, unused, clean
+					// and writable
+    void Remove(int pid, int vpn);	// It is not in memory any more
+
+  private:
+    int Bucket(int pid, int vpn)
+	{ return ((unsigned) (pid * 31 + vpn)) % numBuckets; }
+    InvertedEntry **Link(int pid, int vpn);	// What points to the entry
+					// of the page, or the end of its chain
+
+    InvertedEntry **bucket;		// First entry in each bucket, or NULL
+    int numBuckets;
+    InvertedEntry *freeEntries;		// Unused ones, kept for reuse
 };
 
 #endif
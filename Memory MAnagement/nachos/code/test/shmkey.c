@@ -0,0 +1,48 @@
+/* shmkey.c
+ *	Share memory between processes that are not related, through a
+ *	segment named by a key.  Run two of these in one batch (-F): each
+ *	counts in its own word of the segment, and then waits for the
+ *	other, so both print Total=400.
+ */
+
+#include "syscall.h"
+
+#define KEY 330
+#define NUM_PROCS 2
+#define NUM_ITER 200
+
+int
+main()
+{
+    int id = syscall_wrapper_ShmGet(KEY, NUM_PROCS*sizeof(int));
+    int *array;
+    int me = syscall_wrapper_GetPID() % NUM_PROCS;
+    int i, total;
+
+    if (id < 0) {
+       syscall_wrapper_PrintString("ShmGet failed\n");
+       return 1;
+    }
+    array = (int*)syscall_wrapper_ShmAt(id);
+    if ((int)array == -1) {
+       syscall_wrapper_PrintString("ShmAt failed\n");
+       return 1;
+    }
+    for (i=0; i<NUM_ITER; i++) {
+       array[me]++;
+    }
+    for (i=0; i<NUM_PROCS; i++) {
+       while (array[i] < NUM_ITER) syscall_wrapper_Yield();
+    }
+    total = 0;
+    for (i=0; i<NUM_PROCS; i++) {
+       total += array[i];
+    }
+    syscall_wrapper_PrintString("Total=");
+    syscall_wrapper_PrintInt(total);
+    syscall_wrapper_PrintChar('\n');
+    if (syscall_wrapper_ShmDt((unsigned)array) != 0) {
+       syscall_wrapper_PrintString("ShmDt failed\n");
+    }
+    return 0;
+}
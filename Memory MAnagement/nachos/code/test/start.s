@@ -274,6 +274,30 @@ syscall_wrapper_ShmAllocate:
         j       $31
         .end syscall_wrapper_ShmAllocate
 
+        .globl syscall_wrapper_ShmGet
+        .ent    syscall_wrapper_ShmGet
+syscall_wrapper_ShmGet:
+	addiu $2,$0,SysCall_ShmGet
+        syscall
+        j       $31
+        .end syscall_wrapper_ShmGet
+
+        .globl syscall_wrapper_ShmAt
+        .ent    syscall_wrapper_ShmAt
+syscall_wrapper_ShmAt:
+	addiu $2,$0,SysCall_ShmAt
+        syscall
+        j       $31
+        .end syscall_wrapper_ShmAt
+
+        .globl syscall_wrapper_ShmDt
+        .ent    syscall_wrapper_ShmDt
+syscall_wrapper_ShmDt:
+	addiu $2,$0,SysCall_ShmDt
+        syscall
+        j       $31
+        .end syscall_wrapper_ShmDt
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
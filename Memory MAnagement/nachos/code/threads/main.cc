@@ -24,6 +24,37 @@
 //    -s causes user programs to be executed in single-step mode
 //    -x runs a user program
 //    -c tests the console
+//    -N simulates several CPUs (must come before -x or -F)
+//    -R selects the page replacement algorithm: 1 random, 2 FIFO,
+//	3 LRU, 4 clock, 5 ARC, 6 CAR, 7 2Q, 8 LIRS (must come before
+//	-x or -F)
+//    -FA brings in this many code and data pages on each side of a
+//	faulting page along with it (must come before -x or -F)
+//    -PF brings in this many pages ahead of a process whose page faults
+//	walk sequentially through its address space (must come before
+//	-x or -F)
+//    -PFF gives each process frames by the page-fault-frequency
+//	policy: one that faults again within this many instructions
+//	gets more, one that does not loses the pages it did not use;
+//	processes are swapped out while they want more than there is
+//	(must come before -x or -F)
+//    -PC keeps this many frames clean, by writing dirty pages about
+//	to be replaced to swap ahead of time (must come before -x or -F)
+//    -T records the page references of user programs in a UNIX file
+//	(must come before -x or -F)
+//    -RT replays such a file with each page replacement algorithm
+//    -TLB sets the number of TLB entries, and how many of them make up
+//	a set, of two at least (the vm build only)
+//    -TR selects the TLB replacement policy: 1 random, 2 FIFO, 3 LRU
+//	(the vm build only)
+//    -IPT translates through a hashed inverted page table, with an
+//	entry per page in memory, rather than through the page table of
+//	each process (must come before -x or -F; not in the vm build)
+//    -FC lets each CPU keep up to this many of the frames it frees,
+//	and be given those first (must come before -x or -F)
+//    -J compiles the register arithmetic of hot code to host code,
+//	rather than simulating every user instruction (must come before
+//	-x or -F)
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
@@ -52,6 +83,11 @@
 
 #include "utility.h"
 #include "system.h"
+#ifdef USER_PROGRAM
+#include "pagepolicy.h"
+#include "pagetrace.h"
+#include "jit.h"
+#endif
 
 
 // External functions used by this file
@@ -101,6 +137,7 @@ main(int argc, char **argv)
            schedulingAlgo = atoi(*(argv + 1));
            argCount = 2;
            ASSERT((schedulingAlgo > 0) && (schedulingAlgo <= 4));
+           scheduler->SelectReadyQueue();
            if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
               ASSERT (SCHED_QUANTUM > 0);
            }
@@ -109,6 +146,10 @@ main(int argc, char **argv)
               currentThread->SetPriority(schedPriority+DEFAULT_BASE_PRIORITY);
               currentThread->SetUsage(0);
            }
+        } else if (!strcmp(*argv, "-N")) {	// number of CPUs
+	    ASSERT(argc > 1);
+            scheduler->SetNumProcessors(atoi(*(argv + 1)));
+            argCount = 2;
         } else if (!strcmp(*argv, "-P")) {
             schedPriority = atoi(*(argv + 1));
             argCount = 2;
@@ -138,7 +179,48 @@ main(int argc, char **argv)
         }else if (!strcmp(*argv, "-R")){
             rep_algo = atoi(*(argv + 1));
 	    argCount = 2;
-            ASSERT((rep_algo>0) && (rep_algo<=4));  
+            ASSERT((rep_algo>0) && (rep_algo<=REPLACE_LIRS));  
+            pagePolicy = NewPagePolicy(rep_algo, NumPhysPages);
+	} else if (!strcmp(*argv, "-FA")) {	// fault-around window
+	    ASSERT(argc > 1);
+	    faultAround = atoi(*(argv + 1));
+	    ASSERT(faultAround >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-PFF")) {	// page-fault frequency
+	    ASSERT(argc > 1);
+	    pffInterval = atoi(*(argv + 1));
+	    ASSERT(pffInterval >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-PC")) {	// page cleaner target
+	    ASSERT(argc > 1);
+	    cleanerTarget = atoi(*(argv + 1));
+	    ASSERT(cleanerTarget >= 0);
+	    if (cleanerTarget > 0)
+		swapDisk->SetWriteBehind();
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-FC")) {	// per-CPU frame caches
+	    ASSERT(argc > 1);
+	    frameAllocator->SetCacheSize(atoi(*(argv + 1)));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-J")) {	// compiled code
+	    if (machine->jit == NULL)
+		machine->jit = NewJitBuffer();
+	} else if (!strcmp(*argv, "-IPT")) {	// inverted page table
+	    ASSERT(machine->tlb == NULL);
+	    machine->invertedTable = new InvertedPageTable(NumPhysPages);
+	} else if (!strcmp(*argv, "-PF")) {	// sequential prefetch depth
+	    ASSERT(argc > 1);
+	    prefetchDepth = atoi(*(argv + 1));
+	    ASSERT(prefetchDepth >= 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-T")) {	// record page references
+	    ASSERT(argc > 1);
+	    pageTrace = new PageTrace(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-RT")) {	// replay recorded references
+	    ASSERT(argc > 1);
+	    ReplayTrace(*(argv + 1));
+	    argCount = 2;
 	}
 #endif // USER_PROGRAM
 #ifdef FILESYS
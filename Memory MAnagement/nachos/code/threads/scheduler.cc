@@ -29,20 +29,96 @@
 
 ProcessScheduler::ProcessScheduler()
 { 
-    listOfReadyThreads = new List;
+    for (int i = 0; i < MAX_CPU_COUNT; i++) {
+       processor[i].thread = NULL;
+       processor[i].readyQueue = NULL;
+       processor[i].burstStartTime = 0;
+       processor[i].clock = 0;
+    }
+    processor[0].readyQueue = new FIFOReadyQueue;
+    numProcessors = 1;
+    activeProcessor = 0;
+    activeSince = 0;
     empty_ready_queue_start_time = -1;
 } 
 
 //----------------------------------------------------------------------
 // ProcessScheduler::~ProcessScheduler
-// 	De-allocate the list of ready threads.
+// 	De-allocate the lists of ready threads.
 //----------------------------------------------------------------------
 
 ProcessScheduler::~ProcessScheduler()
 { 
-    delete listOfReadyThreads; 
+    for (int i = 0; i < numProcessors; i++)
+       delete processor[i].readyQueue; 
 } 
 
+//----------------------------------------------------------------------
+// ProcessScheduler::NewReadyQueue
+// 	Return a new, empty ready queue of the kind that suits the 
+//	scheduling algorithm in "schedulingAlgo": a priority queue for the
+//	SJF and UNIX schedulers, which always run the ready thread with 
+//	the lowest priority value, and a FIFO queue otherwise.
+//----------------------------------------------------------------------
+
+ReadyQueue *
+ProcessScheduler::NewReadyQueue (void)
+{
+    if ((schedulingAlgo == UNIX_SCHED) || (schedulingAlgo == NON_PREEMPTIVE_SJF))
+       return new PriorityReadyQueue;
+    return new FIFOReadyQueue;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::SelectReadyQueue
+// 	Switch every CPU to the kind of ready queue that suits the 
+//	scheduling algorithm.  Any threads already queued are carried 
+//	over.  Called whenever the algorithm is chosen.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::SelectReadyQueue (void)
+{
+    ReadyQueue *oldQueue;
+    NachOSThread *thread;
+
+    for (int i = 0; i < numProcessors; i++) {
+       oldQueue = processor[i].readyQueue;
+       processor[i].readyQueue = NewReadyQueue();
+       while ((thread = oldQueue->Remove()) != NULL)
+          processor[i].readyQueue->Append(thread);
+       delete oldQueue;
+    }
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::SetNumProcessors
+// 	Simulate "n" CPUs from now on.  The running thread is on CPU 0,
+//	and the others start out idle; they pick up work as threads 
+//	become ready.  Must be called before there is any thread other 
+//	than the main one.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::SetNumProcessors (int n)
+{
+    ASSERT((n >= 1) && (n <= MAX_CPU_COUNT));
+    ASSERT(numProcessors == 1);
+
+    for (int i = 1; i < n; i++)
+       processor[i].readyQueue = NewReadyQueue();
+    numProcessors = n;
+    stats->numCPUs = n;
+
+    processor[0].thread = currentThread;
+    currentThread->SetCPU(0);
+    for (int i = 0; i < n; i++)
+       processor[i].clock = stats->totalTicks;
+    activeSince = stats->totalTicks;
+    if (n > 1)
+       interrupt->SetSliceEnd(activeSince + SMP_SLICE);
+}
+
 //----------------------------------------------------------------------
 // ProcessScheduler::MoveThreadToReadyQueue
 // 	Mark a thread as ready, but not running.
@@ -78,16 +154,20 @@ ProcessScheduler::MoveThreadToReadyQueue (NachOSThread *thread)
     }
     thread->setStatus(READY);
     thread->SetWaitStartTime(stats->totalTicks);
-    if (listOfReadyThreads->IsEmpty() && (empty_ready_queue_start_time != -1)) {
+
+    // Queue it for the CPU it last ran on, if it has run
+    ReadyQueue *readyQueue = processor[(thread->GetCPU() >= 0) ? thread->GetCPU() : activeProcessor].readyQueue;
+    if (readyQueue->IsEmpty() && (empty_ready_queue_start_time != -1)) {
        stats->empty_ready_queue_time += (stats->totalTicks - empty_ready_queue_start_time);
        empty_ready_queue_start_time = -1;
     }
-    listOfReadyThreads->Append((void *)thread);
+    readyQueue->Append(thread);
 }
 
 //----------------------------------------------------------------------
 // ProcessScheduler::SelectNextReadyThread
-// 	Return the next thread to be scheduled onto the CPU.
+// 	Return the next thread to be scheduled onto the active CPU.  If
+//	none is queued for it, steal one queued for another CPU.
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	NachOSThread is removed from the ready list.
@@ -96,22 +176,41 @@ ProcessScheduler::MoveThreadToReadyQueue (NachOSThread *thread)
 NachOSThread *
 ProcessScheduler::SelectNextReadyThread ()
 {
-    if ((schedulingAlgo == UNIX_SCHED) || (schedulingAlgo == NON_PREEMPTIVE_SJF)){
-       return (NachOSThread *)listOfReadyThreads->GetMinPriorityThread();
-    }
-    else {
-       return (NachOSThread *)listOfReadyThreads->Remove();
+    NachOSThread *thread = processor[activeProcessor].readyQueue->Remove();
+
+    if ((thread == NULL) && (numProcessors > 1))
+       thread = StealReadyThread(activeProcessor);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::StealReadyThread
+// 	Take the next thread off the longest ready queue of any CPU other
+//	than "cpu", for "cpu" to run.  Return NULL if they are all empty.
+//----------------------------------------------------------------------
+
+NachOSThread *
+ProcessScheduler::StealReadyThread (int cpu)
+{
+    int i, busiest = -1;
+
+    for (i = 0; i < numProcessors; i++) {
+       if ((i != cpu) && !processor[i].readyQueue->IsEmpty()
+           && ((busiest == -1) || (processor[i].readyQueue->Length() > processor[busiest].readyQueue->Length())))
+          busiest = i;
     }
+    if (busiest == -1) return NULL;
+    return processor[busiest].readyQueue->Remove();
 }
 
 //----------------------------------------------------------------------
 // ProcessScheduler::ScheduleThread
-// 	Dispatch the CPU to nextThread.  Save the state of the old thread,
-//	and load the state of the new thread, by calling the machine
-//	dependent context switch routine, SWITCH.
+// 	Dispatch the active CPU to nextThread, starting a new CPU burst,
+//	and switch to it.
 //
 //      Note: we assume the state of the previously running thread has
-//	already been changed from running to blocked or ready (depending).
+//	already been changed from running to blocked or ready (depending),
+//	unless it is going on running on another CPU.
 // Side effect:
 //	The global variable currentThread becomes nextThread.
 //
@@ -121,12 +220,35 @@ ProcessScheduler::SelectNextReadyThread ()
 void
 ProcessScheduler::ScheduleThread (NachOSThread *nextThread)
 {
-    NachOSThread *oldThread = currentThread;
-    
     cpu_burst_start_time = stats->totalTicks;
     nextThread->SetCPUBurstStartTime(cpu_burst_start_time);
     stats->total_wait_time += (stats->totalTicks - nextThread->GetWaitStartTime());
 
+    if (nextThread->GetCPU() != activeProcessor) {
+       if (nextThread->GetCPU() >= 0) stats->cpuMigrations[activeProcessor]++;
+       nextThread->SetCPU(activeProcessor);
+    }
+    processor[activeProcessor].thread = nextThread;
+
+    SwitchTo(nextThread);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::SwitchTo
+// 	Save the state of the old thread, and load the state of the new
+//	thread, by calling the machine dependent context switch routine,
+//	SWITCH.  
+// Side effect:
+//	The global variable currentThread becomes nextThread.
+//
+//	"nextThread" is the thread to be put into the CPU.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::SwitchTo (NachOSThread *nextThread)
+{
+    NachOSThread *oldThread = currentThread;
+
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (currentThread->space != NULL) {	// if this thread is a user program,
         currentThread->SaveUserState(); // save the user's CPU registers
@@ -207,7 +329,10 @@ void
 ProcessScheduler::Print()
 {
     printf("Ready list contents:\n");
-    listOfReadyThreads->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int i = 0; i < numProcessors; i++) {
+       if (numProcessors > 1) printf("CPU %d: ", i);
+       processor[i].readyQueue->Mapcar((VoidFunctionPtr) ThreadPrint);
+    }
 }
 
 void
@@ -219,33 +344,345 @@ ProcessScheduler::SetEmptyReadyQueueStartTime (int ticks)
 //-------------------------------------------------------------------------
 // ProcessScheduler::UpdateThreadPriority
 //      Updates the priority of all active threads as in the UNIX scheduler
+//
+//      The running thread is charged for its burst, and every other
+//      thread has its usage halved.  Rather than visiting them all, we
+//      start a new decay epoch; each thread catches up on the epochs it
+//      missed the next time its usage or priority is looked at, which 
+//      gives exactly the same values.
 //--------------------------------------------------------------------------
 void
 ProcessScheduler::UpdateThreadPriority (void)
 {
-   unsigned i;
    int this_cpu_burst_duration = stats->totalTicks - cpu_burst_start_time;
    ASSERT(this_cpu_burst_duration > 0);
-   unsigned currentPID = currentThread->GetPID();
 
    // First we update the currentThread priority
 
    int currentThreadUsage = currentThread->GetUsage();
    currentThreadUsage = (currentThreadUsage + this_cpu_burst_duration) >> 1;
    int currentThreadPriority = currentThread->GetBasePriority() + (currentThreadUsage >> 1);
+
+   // Decay everybody else (setting the usage of currentThread after
+   // this keeps it out of the decay)
+
+   usageDecayEpoch++;
    currentThread->SetUsage(currentThreadUsage);
    currentThread->SetPriority(currentThreadPriority);
 
-   // Update everybody else
-
-   for (i=0; i<thread_index; i++) {
-      if ((i != currentPID) && !exitThreadArray[i]) {
-         ASSERT(threadArray[i] != NULL);
-         currentThreadUsage = threadArray[i]->GetUsage();
-         currentThreadUsage = currentThreadUsage >> 1;
-         currentThreadPriority = threadArray[i]->GetBasePriority() + (currentThreadUsage >> 1);
-         threadArray[i]->SetUsage(currentThreadUsage);
-         threadArray[i]->SetPriority(currentThreadPriority);
-      }
-   }
+   // The ready threads have new priorities now
+   for (int i = 0; i < numProcessors; i++)
+      processor[i].readyQueue->Reorder();
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::EndSlice
+// 	Called when the active CPU has run for its SMP_SLICE ticks.
+//	Unless its thread has used up its quantum (the timer interrupt
+//	that would have noticed may have gone to another CPU), save its
+//	place and run the CPU that is now furthest behind.  Returns when
+//	this thread's CPU gets its next turn.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::EndSlice (void)
+{
+    IntStatus oldLevel;
+
+    if (((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED))
+        && ((stats->totalTicks - cpu_burst_start_time) >= SCHED_QUANTUM)) {
+       currentThread->YieldCPU();
+       return;
+    }
+    oldLevel = interrupt->SetLevel(IntOff);
+    FinishTurn();
+    RunNextProcessor();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::IdleProcessor
+// 	Called when the current thread is giving up the active CPU and
+//	there is no thread for it to run next.  With one CPU, the caller
+//	has to wait for an interrupt; return FALSE.  Otherwise the CPU 
+//	goes idle, and the others run.  Returns TRUE once the current
+//	thread has been dispatched again, on any CPU.
+//
+//	Assumes interrupts are disabled.
+//----------------------------------------------------------------------
+
+bool
+ProcessScheduler::IdleProcessor (void)
+{
+    if (numProcessors == 1) return FALSE;
+
+    FinishTurn();
+    processor[activeProcessor].thread = NULL;
+    RunNextProcessor();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::FinishTurn
+// 	Record where the active CPU's clock got to, and how long it was
+//	busy.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::FinishTurn (void)
+{
+    Processor *cpu = &processor[activeProcessor];
+
+    cpu->burstStartTime = cpu_burst_start_time;
+    cpu->clock = stats->totalTicks - interrupt->Lag();
+    if (cpu->thread != NULL)
+       stats->cpuBusyTicks[activeProcessor] += (cpu->clock - activeSince);
+}
+
+//----------------------------------------------------------------------
+// ProcessScheduler::RunNextProcessor
+// 	Give the CPU whose clock is furthest behind, of those that have 
+//	(or can find) a thread to run, its turn, and switch to its thread.
+//	Of CPUs equally far behind, the one whose turn just ended goes
+//	last.  An idle CPU that takes a thread starts from when the
+//	thread became ready, if that is later than its clock.  If no CPU
+//	has anything to run, wait for an interrupt.
+//
+//	The time itself never goes backwards.  A CPU that is behind it 
+//	has to catch up (see Interrupt::Advance) before it moves the time
+//	on, and it runs until it has, if that takes more than SMP_SLICE.
+//	Since the CPU furthest behind always runs, no CPU gets far ahead
+//	of another.
+//
+//	Returns when the current thread is next switched to.
+//----------------------------------------------------------------------
+
+void
+ProcessScheduler::RunNextProcessor (void)
+{
+    NachOSThread *nextThread;
+    Processor *cpu;
+    int i, next;
+    bool anyReady;
+
+    for (;;) {
+       anyReady = FALSE;		// an idle CPU could take it
+       for (i = 0; i < numProcessors; i++)
+          if (!processor[i].readyQueue->IsEmpty()) anyReady = TRUE;
+       next = -1;
+       for (i = 0; i < numProcessors; i++) {
+          if ((processor[i].thread == NULL) && !anyReady) continue;
+          if ((next == -1) || (processor[i].clock < processor[next].clock)
+              || ((processor[i].clock == processor[next].clock)
+                  && (next == activeProcessor)))
+             next = i;
+       }
+       if (next >= 0) break;
+       interrupt->SetLag(0);
+       interrupt->Idle();	// no one to run, wait for an interrupt
+    }
+
+    activeProcessor = next;
+    cpu = &processor[next];
+    nextThread = cpu->thread;
+    if (nextThread == NULL) {
+       nextThread = cpu->readyQueue->Remove();
+       if (nextThread == NULL) nextThread = StealReadyThread(next);
+       if (cpu->clock < nextThread->GetWaitStartTime())
+          cpu->clock = nextThread->GetWaitStartTime();
+    }
+    activeSince = cpu->clock;
+    interrupt->SetLag(stats->totalTicks - cpu->clock);
+    if (cpu->clock + SMP_SLICE > stats->totalTicks)
+       interrupt->SetSliceEnd(cpu->clock + SMP_SLICE);
+    else
+       interrupt->SetSliceEnd(stats->totalTicks + 1);	// catch up first
+    cpu_burst_start_time = cpu->burstStartTime;
+    if (cpu->thread == NULL)
+       ScheduleThread(nextThread);
+    else if (nextThread != currentThread)
+       SwitchTo(nextThread);
+}
+
+//----------------------------------------------------------------------
+// FIFOReadyQueue::Remove
+// 	Take the thread queued first off the queue and return it, or 
+//	return NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+NachOSThread *
+FIFOReadyQueue::Remove()
+{
+    NachOSThread *thread = (NachOSThread *)list->Remove();
+
+    if (thread != NULL) numThreads--;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::PriorityReadyQueue
+// 	Initialize an empty priority queue of ready threads.
+//----------------------------------------------------------------------
+
+PriorityReadyQueue::PriorityReadyQueue()
+{
+    maxThreads = 16;
+    heap = new NachOSThread*[maxThreads];
+    order = new unsigned[maxThreads];
+    numThreads = 0;
+    nextOrder = 0;
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::~PriorityReadyQueue
+// 	De-allocate the queue.  The threads themselves are not ours.
+//----------------------------------------------------------------------
+
+PriorityReadyQueue::~PriorityReadyQueue()
+{
+    delete [] heap;
+    delete [] order;
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::Before
+// 	Return TRUE if the thread in slot "i" should run before the one
+//	in slot "j": it has a lower priority value, or the same one and
+//	was queued earlier.  This is the order in which the old scan of
+//	the ready list picked threads.
+//----------------------------------------------------------------------
+
+bool
+PriorityReadyQueue::Before(int i, int j)
+{
+    int pi = heap[i]->GetPriority(), pj = heap[j]->GetPriority();
+
+    return (pi < pj) || ((pi == pj) && (order[i] < order[j]));
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::Exchange
+// 	Swap the entries in slots "i" and "j".
+//----------------------------------------------------------------------
+
+void
+PriorityReadyQueue::Exchange(int i, int j)
+{
+    NachOSThread *thread = heap[i];
+    unsigned queued = order[i];
+
+    heap[i] = heap[j];
+    order[i] = order[j];
+    heap[j] = thread;
+    order[j] = queued;
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::SiftUp, PriorityReadyQueue::SiftDown
+// 	Restore the heap order after the entry in "slot" has been placed 
+//	there, by moving it toward the root or toward the leaves.
+//----------------------------------------------------------------------
+
+void
+PriorityReadyQueue::SiftUp(int slot)
+{
+    int parent;
+
+    for (; slot > 0; slot = parent) {
+       parent = (slot - 1) / 2;
+       if (!Before(slot, parent)) break;
+       Exchange(slot, parent);
+    }
+}
+
+void
+PriorityReadyQueue::SiftDown(int slot)
+{
+    int child;
+
+    while ((child = 2*slot + 1) < numThreads) {
+       if ((child + 1 < numThreads) && Before(child + 1, child)) child++;
+       if (!Before(child, slot)) break;
+       Exchange(slot, child);
+       slot = child;
+    }
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::Append
+// 	Add a thread to the queue, behind any others of equal priority.
+//----------------------------------------------------------------------
+
+void
+PriorityReadyQueue::Append(NachOSThread *thread)
+{
+    NachOSThread **newHeap;
+    unsigned *newOrder;
+    int i;
+
+    if (numThreads == maxThreads) {	// grow the arrays
+       newHeap = new NachOSThread*[2*maxThreads];
+       newOrder = new unsigned[2*maxThreads];
+       for (i=0; i<numThreads; i++) {
+          newHeap[i] = heap[i];
+          newOrder[i] = order[i];
+       }
+       delete [] heap;
+       delete [] order;
+       heap = newHeap;
+       order = newOrder;
+       maxThreads *= 2;
+    }
+    heap[numThreads] = thread;
+    order[numThreads] = nextOrder++;
+    SiftUp(numThreads++);
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::Remove
+// 	Take the thread with the lowest priority value (the earliest
+//	queued, if there is a tie) off the queue and return it, or 
+//	return NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+NachOSThread *
+PriorityReadyQueue::Remove()
+{
+    NachOSThread *thread;
+
+    if (numThreads == 0) return NULL;
+    thread = heap[0];
+    numThreads--;
+    if (numThreads > 0) {
+       heap[0] = heap[numThreads];
+       order[0] = order[numThreads];
+       SiftDown(0);
+    }
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::Mapcar
+// 	Apply "func" to every queued thread (in no particular order).
+//----------------------------------------------------------------------
+
+void
+PriorityReadyQueue::Mapcar(VoidFunctionPtr func)
+{
+    for (int i=0; i<numThreads; i++)
+       (*func)((int)heap[i]);
+}
+
+//----------------------------------------------------------------------
+// PriorityReadyQueue::Reorder
+// 	Rebuild the heap after the priorities of queued threads have been
+//	changed in place (as the UNIX scheduler does to every thread after
+//	each CPU burst).  Takes O(n) time.
+//----------------------------------------------------------------------
+
+void
+PriorityReadyQueue::Reorder()
+{
+    for (int i=numThreads/2 - 1; i>=0; i--)
+       SiftDown(i);
 }
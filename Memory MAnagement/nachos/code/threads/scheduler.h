@@ -12,6 +12,91 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "stats.h"
+
+// The following classes define the ready queue: the threads that are 
+// ready to run, but not running.  Which one the scheduler uses depends 
+// on the scheduling algorithm.
+
+class ReadyQueue {
+  public:
+    virtual ~ReadyQueue() {}
+
+    virtual void Append(NachOSThread *thread) = 0;	// Add a ready thread
+    virtual NachOSThread *Remove() = 0;	// Take off the thread to run next,
+					// NULL if there is none
+    virtual bool IsEmpty() = 0;		// Is the queue empty? 
+    virtual int Length() = 0;		// How many threads are queued?
+    virtual void Mapcar(VoidFunctionPtr func) = 0;
+					// Apply "func" to every queued thread
+    virtual void Reorder() {}		// The priorities of queued threads
+					// have changed; restore the order
+};
+
+// First come, first served: used unless threads have priorities.
+
+class FIFOReadyQueue : public ReadyQueue {
+  public:
+    FIFOReadyQueue() { list = new List; numThreads = 0; }
+    ~FIFOReadyQueue() { delete list; }
+
+    void Append(NachOSThread *thread) { list->Append((void *)thread); numThreads++; }
+    NachOSThread *Remove();
+    bool IsEmpty() { return list->IsEmpty(); }
+    int Length() { return numThreads; }
+    void Mapcar(VoidFunctionPtr func) { list->Mapcar(func); }
+
+  private:
+    List *list;
+    int numThreads;		// number of threads on "list"
+};
+
+// Lowest schedPriority first, ties going to the thread queued first:
+// used by the SJF and UNIX schedulers.  Kept as a binary heap, so 
+// adding or removing a thread takes O(log n) time.
+
+class PriorityReadyQueue : public ReadyQueue {
+  public:
+    PriorityReadyQueue();
+    ~PriorityReadyQueue();
+
+    void Append(NachOSThread *thread);
+    NachOSThread *Remove();
+    bool IsEmpty() { return (numThreads == 0); }
+    int Length() { return numThreads; }
+    void Mapcar(VoidFunctionPtr func);
+    void Reorder();
+
+  private:
+    NachOSThread **heap;	// the queued threads
+    unsigned *order;		// when each of them was queued
+    int numThreads;		// number of entries in use
+    int maxThreads;		// size of the arrays
+    unsigned nextOrder;		// "order" of the next thread queued
+
+    bool Before(int i, int j);	// Should heap[i] run before heap[j]?
+    void Exchange(int i, int j);	// Swap two entries
+    void SiftUp(int slot);	// Move an entry toward the root, or
+    void SiftDown(int slot);	// away from it, until it is in order
+};
+
+// The following class records the state of one simulated CPU.  There 
+// is only one MIPS simulator; in SMP mode (-N) the CPUs take turns on 
+// it, each running for SMP_SLICE ticks of its own clock at a time, and
+// the one whose clock is furthest behind always goes next.  A CPU's
+// register file is the saved user state of the thread it is running,
+// so switching CPUs is just a thread switch that leaves both threads
+// running.
+
+class Processor {
+  public:
+    NachOSThread *thread;	// thread it is running, NULL if idle
+    ReadyQueue *readyQueue;	// threads waiting for this CPU
+    int burstStartTime;		// cpu_burst_start_time of "thread", kept
+				// while another CPU is being simulated
+    int clock;			// time it had reached when its last turn
+				// ended
+};
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
@@ -33,12 +118,35 @@ class ProcessScheduler {
     void SetEmptyReadyQueueStartTime (int ticks);
 
     void UpdateThreadPriority (void);	// Used by the UNIX scheduler
+
+    void SelectReadyQueue (void);	// Pick the ready queue that suits
+					// the scheduling algorithm
+
+    void SetNumProcessors (int n);	// Simulate "n" CPUs (SMP mode)
+    void EndSlice (void);		// The active CPU has used up its
+					// turn; let the next one run
+    bool IdleProcessor (void);		// The active CPU has nothing to
+					// run; let the others run
    
   private:
-    List *listOfReadyThreads;  		// queue of threads that are ready to run,
+    Processor processor[MAX_CPU_COUNT];	// the CPUs; each has its own
+				// queue of threads that are ready to run,
 				// but not running
+    int numProcessors;		// how many of them are simulated
+    int activeProcessor;	// the one being simulated now
+    int activeSince;		// its clock when its turn began
 
     int empty_ready_queue_start_time;
+
+    ReadyQueue *NewReadyQueue (void);	// Make a queue for schedulingAlgo
+    NachOSThread *StealReadyThread (int cpu);	// Take a thread queued
+					// for another CPU
+    void FinishTurn (void);		// Book-keeping when the active
+					// CPU's turn ends
+    void RunNextProcessor (void);	// Switch to the CPU furthest
+					// behind that has something to run
+    void SwitchTo (NachOSThread *nextThread);	// Context switch, 
+					// used by ScheduleThread
 };
 
 #endif // SCHEDULER_H
@@ -7,6 +7,10 @@
 
 #include "copyright.h"
 #include "system.h"
+#ifdef USER_PROGRAM
+#include "pagepolicy.h"
+#include "pagetrace.h"
+#endif
 
 // This defines *all* of the global data structures used by Nachos.
 // These are all initialized and de-allocated by this file.
@@ -18,26 +22,24 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
-List* freePages;
-unsigned numPagesAllocated;              // number of physical frames allocated
-unsigned nextunallocatedpage;
 NachOSThread *threadArray[MAX_THREAD_COUNT];  // Array of thread pointers
 unsigned thread_index;			// Index into this array (also used to assign unique pid)
 bool initializedConsoleSemaphores;
 bool exitThreadArray[MAX_THREAD_COUNT];  //Marks exited threads
 
-TimeSortedWaitQueue *sleepQueueHead;	// Needed to implement syscall_wrapper_Sleep
-int page_pid[NumPhysPages];    //Maps each Page entry of every page to thread PID
+SleepWheel *sleepQueue;			// Needed to implement syscall_wrapper_Sleep
 int schedulingAlgo;			// Scheduling algorithm to simulate
 int rep_algo;
+int faultAround;			// Pages on each side of a fault to bring in
+int prefetchDepth;			// Pages to bring in ahead of a sweep
+int pffInterval;			// Page-fault-frequency threshold, if any
+int cleanerTarget;			// Clean frames to keep ready, if any
 char **batchProcesses;			// Names of batch processes
 int *priority;				// Process priority
-TranslationEntry * physical_to_virtual[NumPhysPages];  //Maps each Page Entry to its address of Kernel Page Table
 int cpu_burst_start_time;        // Records the start of current CPU burst
+unsigned usageDecayEpoch;	// Number of usage decays done by the UNIX scheduler
 int completionTimeArray[MAX_THREAD_COUNT];        // Records the completion time of all simulated threads
 bool excludeMainThread;		// Used by completion time statistics calculation
-int Count_ArrLRU[NumPhysPages];
-int Count_ArrFIFO[NumPhysPages];
 int ArrCLRU_s[NumPhysPages];
 int clockindex;
 #ifdef FILESYS_NEEDED
@@ -50,6 +52,18 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+SwapDisk *swapDisk;	// where evicted pages are kept
+TextCache *textCache;	// code pages shared between processes
+ReverseMap *reverseMap;	// the pages mapping each frame
+FrameAllocator *frameAllocator;	// the free frames
+FrameList *fifoFrames;	// frames in the order they were loaded
+FrameList *lruFrames;	// frames in the order they were last used
+ShmTable *shmTable;	// named segments of shared memory
+PagePolicy *pagePolicy = NULL;	// adaptive replacement policy, if any
+PageTrace *pageTrace = NULL;	// page references being recorded, if any
+#ifdef USE_TLB
+TLBManager *tlbManager;		// refills the TLB
+#endif
 #endif
 
 #ifdef NETWORK
@@ -81,15 +95,9 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    TimeSortedWaitQueue *ptr;
     if (interrupt->getStatus() != IdleMode) {
-        // Check the head of the sleep queue
-        while ((sleepQueueHead != NULL) && (sleepQueueHead->GetWhen() <= (unsigned)stats->totalTicks)) {
-           sleepQueueHead->GetThread()->Schedule();
-           ptr = sleepQueueHead;
-           sleepQueueHead = sleepQueueHead->GetNext();
-           delete ptr;
-        }
+        // Wake up the sleepers that are due
+        sleepQueue->WakeUpDue((unsigned)stats->totalTicks);
         //printf("[%d] Timer interrupt.\n", stats->totalTicks);
         if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
            if ((stats->totalTicks - cpu_burst_start_time) >= SCHED_QUANTUM) {
@@ -97,7 +105,180 @@ TimerInterruptHandler(int dummy)
 	      interrupt->YieldOnReturn();
            }
         }
+#ifdef USER_PROGRAM
+        CleanPages();		// write back pages about to be replaced
+#endif
+    }
+}
+
+//----------------------------------------------------------------------
+// SleepWheel::SleepWheel
+// 	Initialize an empty timing wheel of sleeping threads.  A thread
+//	due at time "when" goes in slot when % SLEEP_WHEEL_SIZE, so
+//	finding the threads due at a given tick needs no search.
+//----------------------------------------------------------------------
+
+SleepWheel::SleepWheel (void)
+{
+    int i;
+
+    for (i=0; i<SLEEP_WHEEL_SIZE; i++) {
+       slotHead[i] = NULL;
+       slotTail[i] = NULL;
+    }
+    freeEntries = NULL;
+    lastChecked = 0;
+    depth = 0;
+}
+
+//----------------------------------------------------------------------
+// SleepWheel::~SleepWheel
+// 	De-allocate the wheel, and any entries still on it.
+//----------------------------------------------------------------------
+
+SleepWheel::~SleepWheel (void)
+{
+    TimeSortedWaitQueue *ptr;
+    int i;
+
+    for (i=0; i<SLEEP_WHEEL_SIZE; i++) {
+       while (slotHead[i] != NULL) {
+          ptr = slotHead[i];
+          slotHead[i] = ptr->GetNext();
+          delete ptr;
+       }
+    }
+    while (freeEntries != NULL) {
+       ptr = freeEntries;
+       freeEntries = ptr->GetNext();
+       delete ptr;
+    }
+}
+
+//----------------------------------------------------------------------
+// SleepWheel::Insert
+// 	Put thread "th" on the wheel, to be woken up at time "when".
+//	Threads due at the same time are woken in the order they were
+//	inserted.
+//----------------------------------------------------------------------
+
+void
+SleepWheel::Insert (NachOSThread *th, unsigned when)
+{
+    TimeSortedWaitQueue *ptr;
+    int slot = when % SLEEP_WHEEL_SIZE;
+
+    if (freeEntries != NULL) {
+       ptr = freeEntries;
+       freeEntries = ptr->GetNext();
+       ptr->Reset(th, when);
+    }
+    else {
+       ptr = new TimeSortedWaitQueue (th, when);
+       ASSERT(ptr != NULL);
+    }
+    if (slotHead[slot] == NULL) slotHead[slot] = ptr;
+    else slotTail[slot]->SetNext(ptr);
+    slotTail[slot] = ptr;
+
+    depth++;
+    stats->numSleeps++;
+    if (depth > stats->maxSleepQueueDepth) stats->maxSleepQueueDepth = depth;
+}
+
+//----------------------------------------------------------------------
+// SleepWheel::Wake
+// 	Schedule the thread of a due entry that has been taken off the 
+//	wheel, note how late it is, and keep the entry for reuse.
+//----------------------------------------------------------------------
+
+void
+SleepWheel::Wake (TimeSortedWaitQueue *entry, unsigned now)
+{
+    int lateness = now - entry->GetWhen();
+
+    entry->GetThread()->Schedule();
+    depth--;
+    stats->numWakeups++;
+    stats->totalWakeupLateness += lateness;
+    if (lateness > stats->maxWakeupLateness) stats->maxWakeupLateness = lateness;
+    entry->SetNext(freeEntries);
+    freeEntries = entry;
+}
+
+//----------------------------------------------------------------------
+// SleepWheel::WakeUpDue
+// 	Schedule every thread due at or before time "now", in order of
+//	wakeup time (ties in the order they went to sleep), just as the
+//	old sorted sleep queue did.
+//
+//	Normally only the slots for the ticks since the last call need to 
+//	be looked at.  If a whole turn of the wheel has gone by since then,
+//	every slot may hold due threads; we collect them all and sort them.
+//----------------------------------------------------------------------
+
+void
+SleepWheel::WakeUpDue (unsigned now)
+{
+    TimeSortedWaitQueue *ptr, *prev, *next, *due, *after;
+    unsigned tick;
+    int slot;
+
+    if ((depth == 0) || (now <= lastChecked)) {
+       if (now > lastChecked) lastChecked = now;
+       return;
+    }
+    if (now - lastChecked < SLEEP_WHEEL_SIZE) {
+       for (tick = lastChecked+1; (tick <= now) && (depth > 0); tick++) {
+          slot = tick % SLEEP_WHEEL_SIZE;
+          prev = NULL;
+          for (ptr = slotHead[slot]; ptr != NULL; ptr = next) {
+             next = ptr->GetNext();
+             if (ptr->GetWhen() != tick) {	// due on a later turn
+                prev = ptr;
+                continue;
+             }
+             if (prev == NULL) slotHead[slot] = next;
+             else prev->SetNext(next);
+             if (slotTail[slot] == ptr) slotTail[slot] = prev;
+             Wake(ptr, now);
+          }
+       }
     }
+    else {
+       due = NULL;			// due threads, sorted on when
+       for (slot=0; slot<SLEEP_WHEEL_SIZE; slot++) {
+          prev = NULL;
+          for (ptr = slotHead[slot]; ptr != NULL; ptr = next) {
+             next = ptr->GetNext();
+             if (ptr->GetWhen() > now) {
+                prev = ptr;
+                continue;
+             }
+             if (prev == NULL) slotHead[slot] = next;
+             else prev->SetNext(next);
+             if (slotTail[slot] == ptr) slotTail[slot] = prev;
+             // insert behind any with the same when; all of those
+             // came from this slot, ahead of ptr, so order is kept
+             if ((due == NULL) || (due->GetWhen() > ptr->GetWhen())) {
+                ptr->SetNext(due);
+                due = ptr;
+             }
+             else {
+                for (after = due; (after->GetNext() != NULL) && (after->GetNext()->GetWhen() <= ptr->GetWhen()); after = after->GetNext())
+                   ;
+                ptr->SetNext(after->GetNext());
+                after->SetNext(ptr);
+             }
+          }
+       }
+       while (due != NULL) {
+          next = due->GetNext();
+          Wake(due, now);
+          due = next;
+       }
+    }
+    lastChecked = now;
 }
 
 //----------------------------------------------------------------------
@@ -116,12 +297,12 @@ Initialize(int argc, char **argv)
     int argCount, i;
     char* debugArgs = "";
     bool randomYield = FALSE;
-    freePages = new List;
     initializedConsoleSemaphores = false;
-    numPagesAllocated = 0;
-    nextunallocatedpage = 0;
     schedulingAlgo = NON_PREEMPTIVE_BASE;	// Default
     rep_algo = 0;
+    faultAround = prefetchDepth = 0;		// demand paging only
+    pffInterval = 0;				// one global pool of frames
+    cleanerTarget = 0;				// write pages back on replacement
     batchProcesses = new char*[MAX_BATCH_SIZE];
     ASSERT(batchProcesses != NULL);
     for (i=0; i<MAX_BATCH_SIZE; i++) {
@@ -134,14 +315,18 @@ Initialize(int argc, char **argv)
     
     excludeMainThread = FALSE;
     clockindex = -1;
-    for(i=0;i<NumPhysPages;i++){Count_ArrLRU[i] = -1; Count_ArrFIFO[i] = -1 ; ArrCLRU_s[i] = 0 ;}
+    for(i=0;i<NumPhysPages;i++){ArrCLRU_s[i] = 0 ;}
     for (i=0; i<MAX_THREAD_COUNT; i++) { threadArray[i] = NULL; exitThreadArray[i] = false; completionTimeArray[i] = -1; }
     thread_index = 0;
-    for(i=0;i<NumPhysPages;i++){physical_to_virtual[i]=NULL; page_pid[i]=-1;}
-    sleepQueueHead = NULL;
+    usageDecayEpoch = 0;
+    sleepQueue = new SleepWheel;
     
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    int tlbEntries = TLBSize, tlbWays = TLBSize;	// fully associative
+#endif
+#ifdef USE_TLB
+    int tlbReplacement = TLB_RANDOM;	// as the MIPS tlbwr instruction does
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -171,6 +356,18 @@ Initialize(int argc, char **argv)
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
 #endif
+#ifdef USE_TLB
+	if (!strcmp(*argv, "-TLB")) {		// TLB size, and ways per set
+	    ASSERT(argc > 2);
+	    tlbEntries = atoi(*(argv + 1));
+	    tlbWays = atoi(*(argv + 2));
+	    argCount = 3;
+	} else if (!strcmp(*argv, "-TR")) {	// TLB replacement
+	    ASSERT(argc > 1);
+	    tlbReplacement = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+#endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
@@ -210,7 +407,18 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    machine = new Machine(debugUserProg, tlbEntries, tlbWays);	// this must
+							// come first
+    swapDisk = new SwapDisk("SWAP");
+    textCache = new TextCache();
+    reverseMap = new ReverseMap();
+    frameAllocator = new FrameAllocator(NumPhysPages);
+    fifoFrames = new FrameList(NumPhysPages);
+    lruFrames = new FrameList(NumPhysPages);
+    shmTable = new ShmTable();
+#endif
+#ifdef USE_TLB
+    tlbManager = new TLBManager(tlbReplacement);
 #endif
 
 #ifdef FILESYS
@@ -239,6 +447,18 @@ Cleanup()
 #endif
     
 #ifdef USER_PROGRAM
+    delete pageTrace;
+    delete pagePolicy;
+#ifdef USE_TLB
+    delete tlbManager;
+#endif
+    delete shmTable;
+    delete lruFrames;
+    delete fifoFrames;
+    delete frameAllocator;
+    delete reverseMap;
+    delete textCache;
+    delete swapDisk;
     delete machine;
 #endif
 
@@ -16,8 +16,8 @@
 #include "stats.h"
 #include "timer.h"
 
-#define MAX_THREAD_COUNT 1000
-#define MAX_BATCH_SIZE 100
+#define MAX_THREAD_COUNT 10000
+#define MAX_BATCH_SIZE 1000
 
 // Scheduling algorithms
 #define NON_PREEMPTIVE_BASE 	1
@@ -26,6 +26,7 @@
 #define UNIX_SCHED		4
 
 #define SCHED_QUANTUM		100		// If not a multiple of timer interval, quantum will overshoot
+#define SMP_SLICE		100		// Ticks each CPU runs per turn when simulating several
 
 #define INITIAL_TAU		SystemTick	// Initial guess of the burst is set to the overhead of system activity
 #define ALPHA			0.5
@@ -47,24 +48,28 @@ extern ProcessScheduler *scheduler;			// the ready list
 extern Interrupt *interrupt;			// interrupt status
 extern Statistics *stats;			// performance metrics
 extern Timer *timer;				// the hardware alarm clock
-extern unsigned numPagesAllocated;		// number of physical frames allocated
-extern unsigned nextunallocatedpage;
 extern NachOSThread *threadArray[];  // Array of thread pointers
 extern unsigned thread_index;                  // Index into this array (also used to assign unique pid)
 extern bool initializedConsoleSemaphores;	// Used to initialize the semaphores for console I/O exactly once
 extern bool exitThreadArray[];		// Marks exited threads
-extern List* freePages;                 //List of free pages
 extern int schedulingAlgo;		// Scheduling algorithm to simulate
 extern int rep_algo;			//Page Replacement Algorithm
+extern int faultAround;			// Code and data pages on each side of
+					// a fault to bring in with it (-FA)
+extern int prefetchDepth;		// Pages to bring in ahead of a
+					// sequential sweep (-PF)
+extern int pffInterval;			// Instructions between faults below
+					// which a process needs more frames
+					// (-PFF); 0 for global replacement
+extern int cleanerTarget;		// Frames the page cleaner keeps
+					// clean, ready to be replaced (-PC);
+					// 0 for no cleaner
 extern char **batchProcesses;		// Names of batch executables
 extern int *priority;			// Process priority
-extern int page_pid[];         //Used to access pid of replaced page
 extern int cpu_burst_start_time;	// Records the start of current CPU burst
+extern unsigned usageDecayEpoch;	// Number of usage decays done by the UNIX scheduler
 extern int completionTimeArray[];	// Records the completion time of all simulated threads
 extern bool excludeMainThread;		// Used by completion time statistics calculation
-extern TranslationEntry *physical_to_virtual[];
-extern int Count_ArrLRU[];
-extern int Count_ArrFIFO[];
 extern int ArrCLRU_s[NumPhysPages];
 extern int clockindex;
 
@@ -82,13 +87,59 @@ public:
    unsigned GetWhen (void) { return when; }
    TimeSortedWaitQueue *GetNext(void) { return next; }
    void SetNext (TimeSortedWaitQueue *n) { next = n; }
+   void Reset (NachOSThread *th, unsigned w) { t = th; when = w; next = NULL; }
 };
 
-extern TimeSortedWaitQueue *sleepQueueHead;
+#define SLEEP_WHEEL_SIZE	1024	// Slots in the sleep queue timing wheel
+
+class SleepWheel {			// Sleeping threads, hashed on wakeup time
+private:
+   TimeSortedWaitQueue *slotHead[SLEEP_WHEEL_SIZE];	// Slot i holds the threads
+   TimeSortedWaitQueue *slotTail[SLEEP_WHEEL_SIZE];	// with when % SLEEP_WHEEL_SIZE == i,
+							// in the order they went to sleep
+   TimeSortedWaitQueue *freeEntries;	// Unused entries, kept for reuse
+   unsigned lastChecked;		// All threads due by this time are awake
+   int depth;				// Number of sleeping threads
+
+   void Wake (TimeSortedWaitQueue *entry, unsigned now);	// Wake one thread, recycle its entry
+
+public:
+   SleepWheel (void);
+   ~SleepWheel (void);
+
+   void Insert (NachOSThread *th, unsigned when);	// Put a thread on the wheel
+   void WakeUpDue (unsigned now);		// Schedule every thread with when <= now
+   int GetDepth (void) { return depth; }
+};
+
+extern SleepWheel *sleepQueue;
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "swapdisk.h"
+#include "textcache.h"
+#include "rmap.h"
+#include "frameallocator.h"
+#include "framelist.h"
+#include "shmtable.h"
 extern Machine* machine;	// user program memory and registers
+extern SwapDisk *swapDisk;	// where evicted pages are kept
+extern TextCache *textCache;	// code pages shared between processes
+extern ReverseMap *reverseMap;	// the pages mapping each frame
+extern FrameAllocator *frameAllocator;	// the free frames
+extern FrameList *fifoFrames;	// frames in the order they were loaded
+extern FrameList *lruFrames;	// frames in the order they were last used
+extern ShmTable *shmTable;	// named segments of shared memory
+class PagePolicy;
+extern PagePolicy *pagePolicy;	// adaptive replacement policy (-R 5-8),
+				// NULL for the built-in ones
+class PageTrace;
+extern PageTrace *pageTrace;	// page references being recorded (-T),
+				// if any
+#ifdef USE_TLB
+#include "tlbmanager.h"
+extern TLBManager *tlbManager;	// refills the TLB, and keeps it consistent
+#endif
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
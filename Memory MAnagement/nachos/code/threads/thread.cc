@@ -58,6 +58,7 @@ NachOSThread::NachOSThread(char* threadName, int nice)
 
     childcount = 0;
     waitchild_id = -1;
+    cpu = -1;
 
     for (i=0; i<MAX_CHILD_COUNT; i++) exitedChild[i] = false;
 
@@ -76,6 +77,7 @@ NachOSThread::NachOSThread(char* threadName, int nice)
     }
     schedPriority = basePriority;
     usage = 0;
+    lastDecayEpoch = usageDecayEpoch;
 
     if (schedulingAlgo == NON_PREEMPTIVE_SJF) schedPriority = INITIAL_TAU;
 }
@@ -271,6 +273,8 @@ NachOSThread::Exit (bool terminateSim, int exitcode)
     nextThread = scheduler->SelectNextReadyThread();
     if (nextThread == NULL) {
        scheduler->SetEmptyReadyQueueStartTime(stats->totalTicks);
+       if (!terminateSim && scheduler->IdleProcessor())
+          return;			// not reached: nobody runs us again
     }
     while (nextThread == NULL) {
        if (terminateSim) {
@@ -334,7 +338,11 @@ NachOSThread::YieldCPU ()
           if ((stats->totalTicks - cpu_burst_start_time) < stats->min_cpu_burst) {
              stats->min_cpu_burst = (stats->totalTicks - cpu_burst_start_time);
           }
-          ASSERT(schedulingAlgo != NON_PREEMPTIVE_SJF);
+          // Under SJF, only possible when several CPUs are simulated
+          if (schedulingAlgo == NON_PREEMPTIVE_SJF) {
+             stats->burstEstimateError += abs(stats->totalTicks - cpu_burst_start_time - schedPriority);
+             schedPriority = (int)(ALPHA*(stats->totalTicks - cpu_burst_start_time) + (1-ALPHA)*schedPriority);
+          }
        }
        cpu_burst_start_time = stats->totalTicks;
        SetCPUBurstStartTime(cpu_burst_start_time);
@@ -353,7 +361,8 @@ NachOSThread::YieldCPU ()
 //	we have no thread to run.  "Interrupt::Idle" is called
 //	to signify that we should idle the CPU until the next I/O interrupt
 //	occurs (the only thing that could cause a thread to become
-//	ready to run).
+//	ready to run).  When several CPUs are simulated, the others get
+//	to run instead, until one of them dispatches this thread again.
 //
 //	NOTE: we assume interrupts are already disabled, because it
 //	is called from the synchronization routines which must
@@ -395,6 +404,8 @@ NachOSThread::PutThreadToSleep ()
     nextThread = scheduler->SelectNextReadyThread();
     if (nextThread == NULL) {
        scheduler->SetEmptyReadyQueueStartTime (stats->totalTicks);
+       if (scheduler->IdleProcessor())
+          return;		// other CPUs ran until we were signalled
     }
     while (nextThread == NULL) {
 	interrupt->Idle();	// no one to run, wait for an interrupt
@@ -591,38 +602,7 @@ NachOSThread::Startup()
 void
 NachOSThread::SortedInsertInWaitQueue (unsigned when)
 {
-   TimeSortedWaitQueue *ptr, *prev, *temp;
-
-   if (sleepQueueHead == NULL) {
-      sleepQueueHead = new TimeSortedWaitQueue (this, when);
-      ASSERT(sleepQueueHead != NULL);
-   }
-   else {
-      ptr = sleepQueueHead;
-      prev = NULL;
-      while ((ptr != NULL) && (ptr->GetWhen() <= when)) {
-         prev = ptr;
-         ptr = ptr->GetNext();
-      }
-      if (ptr == NULL) {  // Insert at tail
-         ptr = new TimeSortedWaitQueue (this, when);
-         ASSERT(ptr != NULL);
-         ASSERT(prev->GetNext() == NULL);
-         prev->SetNext(ptr);
-      }
-      else if (prev == NULL) {  // Insert at head
-         ptr = new TimeSortedWaitQueue (this, when);
-         ASSERT(ptr != NULL);
-         ptr->SetNext(sleepQueueHead);
-         sleepQueueHead = ptr;
-      }
-      else {
-         temp = new TimeSortedWaitQueue (this, when);
-         ASSERT(temp != NULL);
-         temp->SetNext(ptr);
-         prev->SetNext(temp);
-      }
-   }
+   sleepQueue->Insert(this, when);
 
    IntStatus oldLevel = interrupt->SetLevel(IntOff);
    //printf("[pid %d] Going to sleep at %d.\n", pid, stats->totalTicks);
@@ -642,6 +622,17 @@ NachOSThread::IncInstructionCount (void)
    instructionCount++;
 }
 
+//----------------------------------------------------------------------
+// NachOSThread::AddInstructionCount
+//      Called by Machine::ExecuteBlock for a run of compiled instructions
+//----------------------------------------------------------------------
+
+void
+NachOSThread::AddInstructionCount (int count)
+{
+   instructionCount += count;
+}
+
 //----------------------------------------------------------------------
 // NachOSThread::GetInstructionCount
 //      Called by SysCall_NumInstr
@@ -679,9 +670,28 @@ NachOSThread::GetCPUBurstStartTime (void)
 
 // Methods used by the UNIX scheduler
 
+//----------------------------------------------------------------------
+// NachOSThread::CatchUpUsageDecay
+//      Apply the usage decays (halvings) this thread has missed since 
+//      it was last looked at, and recompute its priority as
+//      ProcessScheduler::UpdateThreadPriority would have.
+//----------------------------------------------------------------------
+
+void
+NachOSThread::CatchUpUsageDecay (void)
+{
+   unsigned epochs = usageDecayEpoch - lastDecayEpoch;
+
+   if (epochs == 0) return;
+   usage = (epochs < 32) ? (usage >> epochs) : 0;
+   schedPriority = basePriority + (usage >> 1);
+   lastDecayEpoch = usageDecayEpoch;
+}
+
 void 
 NachOSThread::SetBasePriority (int p)
 {
+   CatchUpUsageDecay();
    basePriority = p;
 }
 
@@ -694,23 +704,27 @@ NachOSThread::GetBasePriority (void)
 void 
 NachOSThread::SetPriority (int p)
 {
+   CatchUpUsageDecay();
    schedPriority = p;
 }
     
 int 
 NachOSThread::GetPriority (void)
 {
+   CatchUpUsageDecay();
    return schedPriority;
 }
 
 void 
 NachOSThread::SetUsage (int u)
 {
+   CatchUpUsageDecay();
    usage = u;
 }
     
 int 
 NachOSThread::GetUsage (void)
 {
+   CatchUpUsageDecay();
    return usage;
 }
@@ -115,6 +115,9 @@ class NachOSThread {
     inline int GetPID (void) { return pid; }
     inline int GetPPID (void) { return ppid; }
 
+    inline int GetCPU (void) { return cpu; }
+    inline void SetCPU (int which) { cpu = which; }
+
     void SetChildExitCode (int childpid, int exitcode);	// Called by an exiting child thread
 
     int CheckIfChild (int childpid);			// Called by Join to verify that the caller
@@ -135,6 +138,8 @@ class NachOSThread {
     void SortedInsertInWaitQueue (unsigned when);	// Called by SysCall_Sleep handler
 
     void IncInstructionCount();
+    void AddInstructionCount(int count);	// As "count" calls to
+						// IncInstructionCount
     unsigned GetInstructionCount();
 
     void SetWaitStartTime (int ticks);
@@ -164,6 +169,8 @@ class NachOSThread {
 
     int pid, ppid;			// My pid and my parent's pid
 
+    int cpu;				// CPU I last ran on, -1 if none yet
+
     int childpidArray[MAX_CHILD_COUNT];	// My children
     int childexitcode[MAX_CHILD_COUNT];	// Exit code of my children (return values for Join calls)
     bool exitedChild[MAX_CHILD_COUNT];	// Which children have exited?
@@ -176,6 +183,9 @@ class NachOSThread {
 
     int basePriority, schedPriority, usage;	// Used by the UNIX scheduler
 						// schedPriority is also used to store the next burst estimate
+    unsigned lastDecayEpoch;			// usageDecayEpoch when usage was last decayed
+
+    void CatchUpUsageDecay (void);		// Apply the decays missed since then
 
     unsigned instructionCount;          // Keeps track of the instruction count executed by this thread
 
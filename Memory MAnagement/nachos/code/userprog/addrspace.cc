@@ -18,28 +18,324 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
+#include "pagepolicy.h"
+#include "pagetrace.h"
+#include "noffimage.h"
 //#include <stdlib.h>
+
+static unsigned sharedWrites = 0;	// Pages of shared memory saved so
+					// far; see AllocateNextPage
+//----------------------------------------------------------------------
+// DropMapping
+// 	Page "vpn" of "space" is giving up its mapping of "frame".  If
+//	other processes still map the frame, and this was the owner, the
+//	next one becomes the owner, under its own pid as far as the page
+//	replacement policy is concerned.  A page of shared memory stays
+//	dirty if this process had written to it.
+//----------------------------------------------------------------------
+
+static void
+DropMapping (int frame, ProcessAddressSpace *space, int vpn)
+{
+    TranslationEntry *entry = &space->GetPageTable()[vpn];
+    bool dirty = space->Resident(vpn)->dirty;
+    int owner = reverseMap->Owner(frame);
+
+    reverseMap->Remove(frame, space, vpn);
+    if (reverseMap->Count(frame) == 0)
+	return;
+    if (entry->shared && dirty)
+	reverseMap->Mappings(frame)->Resident()->dirty = TRUE;
+    if ((pagePolicy != NULL) && (reverseMap->Owner(frame) != owner))
+	pagePolicy->Rename(frame, reverseMap->Owner(frame));
+}
+
+//----------------------------------------------------------------------
+// AccountPrefetch
+// 	"entry" is losing its frame, and "resident" is its translation.
+//	If the page was prefetched, count it as used if it was referenced
+//	since, and as wasted otherwise.
+//----------------------------------------------------------------------
+
+static void
+AccountPrefetch (TranslationEntry *entry, TranslationEntry *resident)
+{
+    if (!entry->prefetched)
+	return;
+    if (resident->use)
+	stats->numPrefetchHits++;
+    else
+	stats->numPrefetchWasted++;
+    entry->prefetched = FALSE;
+}
+
+//----------------------------------------------------------------------
+// InitEntry
+// 	Make "entry" page "vpn" of nothing yet: a page of zeroes, on
+//	its first use.
+//----------------------------------------------------------------------
+
+static void
+InitEntry (TranslationEntry *entry, int vpn)
+{
+    entry->virtualPage = vpn;
+    entry->physicalPage = -1;
+    entry->valid = FALSE;
+    entry->use = FALSE;
+    entry->dirty = FALSE;
+    entry->readOnly = FALSE;
+    entry->shared = FALSE;
+    entry->backup = FALSE;
+    entry->swapSlot = -1;
+    entry->copyOnWrite = FALSE;
+    entry->prefetched = FALSE;
+    entry->unmapped = FALSE;
+}
+
+//----------------------------------------------------------------------
+// SaveAndUnmap
+// 	Take "frame" away from page "vpn" of "space", of thread "pid",
+//	writing the contents to its swap slot if they have changed.
+//	A slot still shared with a forked process keeps the old contents;
+//	the entry gets a slot of its own.
+//----------------------------------------------------------------------
+
+static void
+SaveAndUnmap (int pid, ProcessAddressSpace *space, int vpn, int frame)
+{
+    TranslationEntry *entry = &space->GetPageTable()[vpn];
+    TranslationEntry *resident = space->Resident(vpn);
+    bool dirty = resident->dirty;
+
+#ifdef USE_TLB
+    tlbManager->InvalidateFrame(frame);
+#endif
+    AccountPrefetch(entry, resident);
+    space->UnmapPage(vpn);
+    entry->copyOnWrite = FALSE;		// it is private once reloaded
+   if (dirty==TRUE)
+   {
+        if ((entry->swapSlot >= 0) && swapDisk->IsShared(entry->swapSlot)) {
+            swapDisk->ReleaseSlot(entry->swapSlot);
+            entry->swapSlot = -1;
+        }
+        if (entry->swapSlot < 0) {
+            entry->swapSlot = swapDisk->AllocateSlot();
+            ASSERT(entry->swapSlot >= 0);	// swap area full
+        }
+        entry->backup = TRUE;
+        DEBUG('t',"Setting backup to true for pid = %d, vpn = %d, slot = %d\n",pid,entry->virtualPage,entry->swapSlot);
+        swapDisk->WritePage(entry->swapSlot, &machine->mainMemory[frame*PageSize]);
+        stats->numDirtyEvictions++;
+    }
+}
+
+//----------------------------------------------------------------------
+// SaveShared
+// 	Write the page of shared memory in "frame" to its swap slot, if
+//	any process mapping it has written to it, and mark it clean in
+//	all of them.  The first time the page is saved it is given a
+//	slot, with a reference for each process; every process sharing
+//	the page maps it then, since it has never left memory.  It keeps
+//	the slot from then on, as the processes may fault it back in at
+//	different times.
+//
+//	Returns FALSE if the swap area is full.  Sets "wrote" if it
+//	queued a write.
+//----------------------------------------------------------------------
+
+static bool
+SaveShared (int frame, bool *wrote)
+{
+    FrameMapping *mapping;
+    int slot = reverseMap->OwnerEntry(frame)->swapSlot;
+    bool dirty = FALSE;
+
+    *wrote = FALSE;
+    for (mapping = reverseMap->Mappings(frame); mapping != NULL; mapping = mapping->next)
+	dirty = dirty || mapping->Resident()->dirty;
+    if (slot < 0) {
+	slot = swapDisk->AllocateSlot();
+	if (slot < 0)
+	    return FALSE;
+	for (mapping = reverseMap->Mappings(frame); mapping != NULL; mapping = mapping->next) {
+	    ASSERT(mapping->Entry()->swapSlot < 0);
+	    if (mapping != reverseMap->Mappings(frame))
+		swapDisk->ShareSlot(slot);
+	    mapping->Entry()->swapSlot = slot;
+	    mapping->Entry()->backup = TRUE;
+	}
+	dirty = TRUE;			// the slot holds nothing yet
+    }
+    if (!dirty)
+	return TRUE;
+    swapDisk->WritePage(slot, &machine->mainMemory[frame*PageSize]);
+    sharedWrites++;
+    for (mapping = reverseMap->Mappings(frame); mapping != NULL; mapping = mapping->next)
+	mapping->Resident()->dirty = FALSE;
+    *wrote = TRUE;
+    DEBUG('t', "Saved shared PHYSICAL %d, mapped %d times, to slot %d\n",
+		frame, reverseMap->Count(frame), slot);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// UnmapFrame
+// 	Take "frame" away from every process that maps it, saving the
+//	page to the swap area first if it has changed.  A page of shared
+//	memory is saved once, to the slot all the processes share; a page
+//	shared copy-on-write is saved for each process on its own, as
+//	each has a slot of its own (see SaveAndUnmap).
 //----------------------------------------------------------------------
-// SwapHeader
-// 	Do little endian to big endian conversion on the bytes in the 
-//	object file header, in case the file was generated on a little
-//	endian machine, and we're now running on a big endian machine.
+
+static void
+UnmapFrame (int frame)
+{
+    FrameMapping *mapping;
+    bool saved, wrote;
+
+    if (reverseMap->OwnerEntry(frame)->shared) {
+#ifdef USE_TLB
+	tlbManager->InvalidateFrame(frame);
+#endif
+	saved = SaveShared(frame, &wrote);
+	ASSERT(saved);			// swap area full
+	for (mapping = reverseMap->Mappings(frame); mapping != NULL; mapping = mapping->next) {
+	    AccountPrefetch(mapping->Entry(), mapping->Resident());
+	    mapping->space->UnmapPage(mapping->vpn);
+	}
+	if (wrote)
+	    stats->numDirtyEvictions++;
+	stats->numSharedEvictions++;
+    } else
+	for (mapping = reverseMap->Mappings(frame); mapping != NULL; mapping = mapping->next)
+	    SaveAndUnmap(mapping->pid, mapping->space, mapping->vpn, frame);
+    reverseMap->Clear(frame);
+}
+
+//----------------------------------------------------------------------
+// ReclaimFrame
+// 	Take "frame", chosen for replacement, away from the pages mapping
+//	it, and from the lists of the replacement policies, for the
+//	caller to give to another page.
+//----------------------------------------------------------------------
+
+static void
+ReclaimFrame (int frame)
+{
+    int pid = reverseMap->Owner(frame);
+    int vpn = reverseMap->Mappings(frame)->vpn;
+
+    machine->InvalidateDecodedFrame(frame);
+    textCache->Remove(frame);
+    fifoFrames->Remove(frame);		// the caller puts it back
+    lruFrames->Remove(frame);
+    if (pagePolicy != NULL)
+	pagePolicy->Evict(frame);
+    UnmapFrame(frame);			// from every process mapping it
+    stats->numFrameAllocations++;
+    DEBUG('t',"Replaced page from pid = %d vpn = %d PhysPageNum = %d\n",pid,vpn,frame);
+}
+
+//----------------------------------------------------------------------
+// CleanFrame
+// 	Write the page in "frame" to its swap slot now, if it is dirty,
+//	so that replacing the frame later needs no write.  The page stays
+//	mapped; a write to it makes it dirty again.
+//
+//	Returns TRUE if the frame is clean now, FALSE if it holds a dirty
+//	page shared copy-on-write, or the swap area is full.  Sets "wrote"
+//	if it queued a write.
 //----------------------------------------------------------------------
 
-static void 
-SwapHeader (NoffHeader *noffH)
+static bool
+CleanFrame (int frame, bool *wrote)
 {
-	noffH->noffMagic = WordToHost(noffH->noffMagic);
-	noffH->code.size = WordToHost(noffH->code.size);
-	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
-	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
-	noffH->initData.size = WordToHost(noffH->initData.size);
-	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
-	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
-	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
-	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
-	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+    FrameMapping *owner = reverseMap->Mappings(frame);
+    TranslationEntry *entry, *resident;
+
+    *wrote = FALSE;
+    if ((owner == NULL) || ((resident = owner->Resident()) == NULL))
+	return FALSE;
+    entry = owner->Entry();
+    if (entry->shared) {
+	if (!SaveShared(frame, wrote))
+	    return FALSE;
+	if (*wrote)
+	    stats->numPagesCleaned++;
+	return TRUE;
+    }
+    if (!resident->dirty)
+	return TRUE;
+    if (entry->copyOnWrite || (reverseMap->Count(frame) > 1))
+	return FALSE;
+    if ((entry->swapSlot >= 0) && swapDisk->IsShared(entry->swapSlot)) {
+	swapDisk->ReleaseSlot(entry->swapSlot);
+	entry->swapSlot = -1;
+    }
+    if (entry->swapSlot < 0) {
+	entry->swapSlot = swapDisk->AllocateSlot();
+	if (entry->swapSlot < 0)
+	    return FALSE;
+    }
+    entry->backup = TRUE;
+    swapDisk->WritePage(entry->swapSlot, &machine->mainMemory[frame*PageSize]);
+    resident->dirty = FALSE;
+    stats->numPagesCleaned++;
+    *wrote = TRUE;
+    DEBUG('t', "Cleaned pid = %d, vpn = %d in frame %d, slot = %d\n",
+		reverseMap->Owner(frame), entry->virtualPage, frame, entry->swapSlot);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CleanPages
+// 	The page cleaner (-PC).  Called from the timer interrupt, with
+//	interrupts off; it never waits, since writes to the swap area
+//	only queue a copy of the page.
+//
+//	Walks the frames in the order PageReplace will take them -- the
+//	FIFO or LRU list, or round from the clock hand -- writing dirty
+//	pages ahead of time until "cleanerTarget" frames, counting the
+//	free ones, can be taken without a write.  It only starts once
+//	the swap disk has nothing else to do, and writes at most
+//	CleanerBatch pages at a time.  The swap disk holds its writes
+//	back behind the reads of faulting processes (see swapdisk.h).
+//----------------------------------------------------------------------
+
+void
+CleanPages ()
+{
+    static int hand = 0;		// Where the last round stopped, for
+					// the policies with no list
+    FrameList *order = NULL;
+    int frame, scanned, clean, written = 0;
+    bool wrote;
+
+    if ((cleanerTarget == 0) || (rep_algo == 0))
+	return;
+    swapDisk->Flush();
+    if (swapDisk->Busy() || (frameAllocator->NumFree() >= cleanerTarget))
+	return;
+    if (rep_algo == 2)
+	order = fifoFrames;
+    else if (rep_algo == 3)
+	order = lruFrames;
+    else if (rep_algo == 4)
+	hand = (clockindex + 1) % NumPhysPages;
+    clean = frameAllocator->NumFree();
+    frame = (order != NULL) ? order->First(-1) : hand;
+    for (scanned = 0; (scanned < NumPhysPages) && (frame != -1)
+		&& (clean < cleanerTarget) && (written < CleanerBatch); scanned++) {
+	if (CleanFrame(frame, &wrote))
+	    clean++;
+	if (wrote)
+	    written++;
+	frame = (order != NULL) ? order->Next(frame) : (frame + 1) % NumPhysPages;
+    }
+    if (order == NULL)
+	hand = frame;
+    swapDisk->Flush();
 }
 
 //----------------------------------------------------------------------
@@ -54,22 +350,22 @@ SwapHeader (NoffHeader *noffH)
 //	memory.  For now, this is really simple (1:1), since we are
 //	only uniprogramming, and we have a single unsegmented page table
 //
-//	"executable" is the file containing the object code to load into memory
+//	"executable" is the file containing the object code to load into
+//	memory; the address space takes it over
+//	"name" is the name it was opened under; code pages of the same name
+//	that other processes already have in memory are mapped at once
+//	"thread_pid" is the process that will run in it
 //----------------------------------------------------------------------
 
-ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
+ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable, char *name, int thread_pid)
 {
     NoffHeader noffH;
     unsigned int i, size;
     unsigned vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
-    openexecutable = executable;
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    image = NoffImage::Open(executable, name);
+    noffH = *image->Header();
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
@@ -77,7 +373,6 @@ ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
 						// to leave room for the stack
     numVirtualPages = divRoundUp(size, PageSize);
     size = numVirtualPages * PageSize;
-    backup = new char[size];
     /*if (rep_algo == 0){
 	ASSERT(numVirtualPages+numPagesAllocated <= NumPhysPages);		// check we're not trying
 										// to run anything too big --
@@ -133,6 +428,7 @@ ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
 	}
     }else{*/
     KernelPageTable = new TranslationEntry[numVirtualPages];
+    tableSize = numVirtualPages;
     for (i = 0; i < numVirtualPages; i++) {
         KernelPageTable[i].virtualPage = i;
         KernelPageTable[i].physicalPage = -1;
@@ -143,7 +439,39 @@ ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
         KernelPageTable[i].shared = FALSE; // a separate page, we could set its 
                                 // pages to be read-only
         KernelPageTable[i].backup = FALSE;
+        KernelPageTable[i].swapSlot = -1;
+        KernelPageTable[i].copyOnWrite = FALSE;
+        KernelPageTable[i].prefetched = FALSE;
+        KernelPageTable[i].unmapped = FALSE;
     }
+    pid = thread_pid;
+    streamNext = -1;
+    streamLength = 0;
+    quota = PffMinQuota;
+    lastFault = 0;
+    asid = -1;
+    asidGeneration = 0;
+    suspended = FALSE;
+    resumedAt = 0;
+
+    // the pages before the end of the code are code only, if the code
+    // starts at 0, as coff2noff puts it; a name too long to keep is
+    // not shared
+    numTextPages = 0;
+    filename[0] = '\0';
+    if ((noffH.code.virtualAddr == 0) && (strlen(name) < sizeof(filename))) {
+        strcpy(filename, name);
+        numTextPages = noffH.code.size / PageSize;
+    }
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    for (vpn = 0; vpn < numTextPages; vpn++) {
+        int frame = textCache->Lookup(filename, vpn);
+        if (frame >= 0) {
+            MapText(vpn, frame);
+            stats->numSharedText++;
+        }
+    }
+    (void) interrupt->SetLevel(oldLevel);
 //	machine->KernelPageTable = KernelPageTable;
   //      machine->KernelPageTableSize = size;
 //        bzero(&machine->mainMemory[numPagesAllocated*PageSize], size);
@@ -154,72 +482,74 @@ ProcessAddressSpace::ProcessAddressSpace(OpenFile *executable)
 //----------------------------------------------------------------------
 // ProcessAddressSpace::ProcessAddressSpace (ProcessAddressSpace*) is called by a forked thread.
 //      We need to duplicate the address space of the parent.
+//
+//      The pages the parent has in memory are not copied: parent and
+//      child share the frames, read-only, until one of them writes to
+//      a page (see CopyOnWrite).  The parent stays the owner of the
+//      frames; the child is added to the reverse map of each, and gets
+//      translations of its own to them.  Pages
+//      the parent has in the swap area are shared the same way, by
+//      taking a reference to their slots.  Shared memory stays shared,
+//      and the child has the segments the parent has attached.
 //----------------------------------------------------------------------
 
 ProcessAddressSpace::ProcessAddressSpace(ProcessAddressSpace *parentSpace, int child_pid)
 {
     numVirtualPages = parentSpace->GetNumPages();
-    unsigned i,j, size = numVirtualPages * PageSize;
-    openexecutable = parentSpace->openexecutable;
-    //ASSERT(numVirtualPages+numPagesAllocated <= NumPhysPages);                // check we're not trying
-    backup = new char[size];                                                    // to run anything too big --
-                                                                                // at least until we have
-                                                                                // virtual memory
+    unsigned i, size = numVirtualPages * PageSize;
+    image = parentSpace->image;
+    image->Retain();
+    strcpy(filename, parentSpace->filename);
+    numTextPages = parentSpace->numTextPages;
+    pid = child_pid;
+    streamNext = -1;
+    streamLength = 0;
+    quota = parentSpace->quota;		// it starts out with the same pages
+    lastFault = 0;
+    asid = -1;
+    asidGeneration = 0;
+    suspended = FALSE;
+    resumedAt = 0;
 
     DEBUG('a', "Fork Initializing address space, num pages %d, size %d\n",
                                         numVirtualPages, size);
     // first, set up the translation
     TranslationEntry* parentPageTable = parentSpace->GetPageTable();
+    TranslationEntry *from, *to;
  IntStatus oldLevel = interrupt->SetLevel(IntOff); // disable interrupts
     KernelPageTable = new TranslationEntry[numVirtualPages];
+    tableSize = numVirtualPages;
     for (i = 0; i < numVirtualPages; i++) {
-        KernelPageTable[i].virtualPage = i;
-        if (parentPageTable[i].shared ==TRUE){
-            KernelPageTable[i].physicalPage = parentPageTable[i].physicalPage;
+        from = parentSpace->Resident(i);
+        if ((from != NULL) && !parentPageTable[i].shared) {
+            from->readOnly = TRUE;		// until somebody writes
+            parentPageTable[i].copyOnWrite = TRUE;
+#ifdef USE_TLB
+            tlbManager->InvalidatePage(i);	// the parent is running
+#endif
+            DEBUG('t',"In fork, sharing PHYSICAL %d at VIRTUAL %d with pid = %d \n",from->physicalPage,i,child_pid);
         }
-        else if (parentPageTable[i].valid == TRUE){
-            stats->numPageFaults++;
-            if(numPagesAllocated < NumPhysPages){
-                if (nextunallocatedpage < NumPhysPages)                /// do remember to reverse this if block later
-                    KernelPageTable[i].physicalPage = nextunallocatedpage++;
-                else{
-                    int*  fp = (int *)freePages->Remove();
-                    KernelPageTable[i].physicalPage =  *fp;
-                }
-                numPagesAllocated++;
-            }else if (rep_algo!=0){
-		DEBUG('t', "Page replace called in child address spce");	
-                KernelPageTable[i].physicalPage = PageReplace(parentPageTable[i].physicalPage);
-            }else ASSERT(numPagesAllocated < NumPhysPages);
-	    
-	    bzero(&machine->mainMemory[(KernelPageTable[i].physicalPage)*PageSize], PageSize);
-            for (j=0;j<PageSize;j++){
-                machine->mainMemory[KernelPageTable[i].physicalPage*PageSize+j] = machine->mainMemory[parentPageTable[i].physicalPage*PageSize+j];
-            }
-            page_pid[KernelPageTable[i].physicalPage] = child_pid; 
-            physical_to_virtual[KernelPageTable[i].physicalPage]=&KernelPageTable[i];
-            DEBUG('t',"In fork,PHYSICAL %d TO VIRTUAL %d pid = %d \n",KernelPageTable[i].physicalPage,physical_to_virtual[KernelPageTable[i].physicalPage]->virtualPage,page_pid[KernelPageTable[i].physicalPage]);
-            Count_ArrLRU[KernelPageTable[i].physicalPage] = stats->totalTicks;
-            Count_ArrFIFO[KernelPageTable[i].physicalPage] = stats->totalTicks;
-            Count_ArrLRU[parentPageTable[i].physicalPage] = stats->totalTicks + 1;
-            ArrCLRU_s[KernelPageTable[i].physicalPage] = 1;
-            ArrCLRU_s[parentPageTable[i].physicalPage] = 1;
-	    currentThread->SortedInsertInWaitQueue(stats->totalTicks+1000); //put it in sleep
-        }else{
+        KernelPageTable[i] = parentPageTable[i];	// where it is kept
+        KernelPageTable[i].prefetched = FALSE;	// the parent accounts for it
+        if (KernelPageTable[i].swapSlot >= 0)
+            swapDisk->ShareSlot(KernelPageTable[i].swapSlot);
+        if (from != NULL) {
+            to = MapPage(i, from->physicalPage);
+            to->readOnly = from->readOnly;
+            to->use = from->use;
+            to->dirty = from->dirty;
+            reverseMap->Add(from->physicalPage, child_pid, this, i);
+        } else if (!KernelPageTable[i].shared)
             KernelPageTable[i].physicalPage = -1;
-        }
-            KernelPageTable[i].valid = parentPageTable[i].valid;
-            KernelPageTable[i].use = parentPageTable[i].use;
-            KernelPageTable[i].dirty = parentPageTable[i].dirty;
-            KernelPageTable[i].readOnly = parentPageTable[i].readOnly;  	// if the code segment was entirely on
-            KernelPageTable[i].shared = parentPageTable[i].shared;                // a separate page, we could set its
-            KernelPageTable[i].backup = parentPageTable[i].backup;
-            //DEBUG('t',"Backup = %d vpn = %d \n",KernelPageTable[i].backup, i ); 		//be read-only
-                        
-        }
-        //copy backup
-    for (i=0;i<size;i++)
-	    backup[i] = parentSpace->backup[i];
+    }
+    for (int id = 0; id < MaxShmSegments; id++) {	// and so do segments
+        if (shmTable->Segment(id) == NULL)
+            continue;
+        for (ShmAttachment *attachment = shmTable->Attachments(id);
+                        attachment != NULL; attachment = attachment->next)
+            if (attachment->space == parentSpace)
+                shmTable->Attach(id, this, attachment->base);
+    }
  (void) interrupt->SetLevel(oldLevel); // re-enable interrupt
     // Copy the contents
     //unsigned startAddrParent = parentPageTable[0].physicalPage*PageSize;
@@ -239,84 +569,208 @@ ProcessAddressSpace::ProcessAddressSpace(ProcessAddressSpace *parentSpace, int c
 
 }
 //---------------------------------------------------------------------
-// int ProcessAddressSpace::ProcessAddressSpace (int shared_size) is called by a syscall Shm_Allocate.
-//      We need to duplicate the address space of the currentThread + add new shared space.
+// ProcessAddressSpace::ShmAllocate
+//      Called by the system call ShmAllocate: add "shared_size" bytes
+//      of shared memory at the end of the address space.  The children
+//      this process forks from now on share it.
+//      The shared pages are replaced like any other, from all the
+//      processes mapping them at once (see UnmapFrame).
 //----------------------------------------------------------------------
 void ProcessAddressSpace::ShmAllocate(int shared_size)
 {
-    //numVirtualPages = currentThread->space->GetNumPages();
-    unsigned i, size = numVirtualPages * PageSize;
-    int shared_pages = divRoundUp(shared_size, PageSize);
-    stats->numPageFaults += shared_pages;
-    ASSERT(shared_pages+numPagesAllocated <= NumPhysPages);                // check we're not trying
+    int i, first, shared_pages = divRoundUp(shared_size, PageSize);
+    ASSERT((rep_algo != 0) || (shared_pages <= frameAllocator->NumFree()));	// check we're not trying
                                                                                 // to run anything too big --
                                                                                 // at least until we have
                                                                                 // virtual memory
 
     DEBUG('a', "Initializing address space in shmallocate, num pages %d, size %d\n",
-                                        numVirtualPages+shared_pages, size+shared_pages*PageSize);
-    // first, set up the translation
-    TranslationEntry* OldTable = KernelPageTable;
-    KernelPageTable = new TranslationEntry[numVirtualPages+shared_pages];
-    for (i = 0; i < numVirtualPages; i++) {
+                                        numVirtualPages+shared_pages, (numVirtualPages+shared_pages)*PageSize);
+    IntStatus oldLevel = interrupt->SetLevel(IntOff); // pages may be replaced
+    first = GrowPageTable(shared_pages);
+    for (i = first; i < first + shared_pages; i++)
+        NewSharedPage(i);
+    (void) interrupt->SetLevel(oldLevel);
+}
 
-        KernelPageTable[i].virtualPage = OldTable[i].virtualPage;
-        KernelPageTable[i].physicalPage = OldTable[i].physicalPage;
-        KernelPageTable[i].valid = OldTable[i].valid;
-        KernelPageTable[i].use = OldTable[i].use;
-        KernelPageTable[i].dirty = OldTable[i].dirty;
-        KernelPageTable[i].readOnly = OldTable[i].readOnly;      // if the code segment was entirely on
-        KernelPageTable[i].shared = OldTable[i].shared;         // a separate page, we could set its
-        KernelPageTable[i].backup = OldTable[i].backup;         // pages to be read-only
-	//DEBUG('t',"VPN = %d PhysPage = %d \n",OldTable[i].virtualPage,OldTable[i].physicalPage);
-        if(KernelPageTable[i].valid==TRUE)
-            physical_to_virtual[KernelPageTable[i].physicalPage]=&KernelPageTable[i];
-
-    }
-    //DEBUG('a', "Hi 1\n");
-    for (i = numVirtualPages; i < numVirtualPages+shared_pages; i++) {
-        KernelPageTable[i].virtualPage = i;
-        //KernelPageTable[i].physicalPage = nextunallocatedpage++;
-	if(numPagesAllocated < NumPhysPages){
-        if (nextunallocatedpage < NumPhysPages)                /// do remember to reverse this if block later
-                KernelPageTable[i].physicalPage = nextunallocatedpage++;
-		else{
-			int*  fp = (int *)freePages->Remove();
-                        KernelPageTable[i].physicalPage =  *fp;}
-                numPagesAllocated++;
-        }else if (rep_algo!=0){
-		DEBUG('t',"Called page replace in shmallocate\n");
-                KernelPageTable[i].physicalPage = PageReplace(-1);//replace a page
-        }else ASSERT(numPagesAllocated < NumPhysPages);
-	DEBUG('t',"assigned vpn %d to ppn %d in shm\n",i,KernelPageTable[i].physicalPage );
-        //DEBUG('t',"Shared Page vpn = %d Physpn = %d pid = [%d]",i,KernelPageTable[i].physicalPage,currentThread->GetPID());
-	bzero(&machine->mainMemory[(KernelPageTable[i].physicalPage)*PageSize], PageSize);
-        physical_to_virtual[KernelPageTable[i].physicalPage]=&KernelPageTable[i];
-        KernelPageTable[i].valid = TRUE;
-        KernelPageTable[i].use = FALSE;
-        KernelPageTable[i].dirty = FALSE;
-        KernelPageTable[i].readOnly = FALSE;  // if the code segment was entirely on 
-        KernelPageTable[i].shared = TRUE; // a separate page, we could set its 
-        KernelPageTable[i].backup = FALSE;             // pages to be read-only
-        //DEBUG('t',"VPN = %d PhysPage = %d \n",OldTable[i].virtualPage,OldTable[i].physicalPage);
+//----------------------------------------------------------------------
+// ProcessAddressSpace::ShmAttach
+// 	Attach segment "id" at the end of the address space.  If another
+//	process has it attached, map its pages the way that process does,
+//	as a child does at a fork; if nobody has, take over the swap slots
+//	the segment kept its pages in, or zero the pages on its first
+//	attach.
+//
+//	Returns the virtual address of the segment, or -1 if there is no
+//	segment "id".
+//----------------------------------------------------------------------
+
+int
+ProcessAddressSpace::ShmAttach(int id)
+{
+    ShmSegment *segment = shmTable->Segment(id);
+    ShmAttachment *other;
+    TranslationEntry *entry, *from, *resident;
+    int i, base;
 
+    if (segment == NULL)
+	return -1;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff); // pages may be replaced
+    other = segment->attached;
+    base = GrowPageTable(segment->numPages);
+    for (i = 0; i < segment->numPages; i++) {
+	entry = &KernelPageTable[base + i];
+	if (other != NULL) {
+	    from = &other->space->GetPageTable()[other->base + i];
+	    resident = other->space->Resident(other->base + i);
+	    ASSERT(from->shared);
+	    entry->shared = TRUE;
+	    entry->backup = from->backup;
+	    entry->swapSlot = from->swapSlot;
+	    if (resident != NULL) {
+		MapPage(base + i, resident->physicalPage);
+		reverseMap->Add(resident->physicalPage, currentThread->GetPID(), this, base + i);
+	    }
+	    if (entry->swapSlot >= 0)
+		swapDisk->ShareSlot(entry->swapSlot);
+	} else if (segment->slot[i] >= 0) {
+	    entry->shared = TRUE;
+	    entry->backup = TRUE;
+	    entry->swapSlot = segment->slot[i];	// and its reference
+	    segment->slot[i] = -1;
+	} else
+	    NewSharedPage(base + i);
     }
-   //DEBUG('a', "Hi 2\n");
-   //numPagesAllocated += shared_pages;
-   numVirtualPages += shared_pages;
-    // Copy the contents
-    //unsigned startAddrParent = parentPageTable[0].physicalPage*PageSize;
-    //unsigned startAddrChild = numPagesAllocated*PageSize;
-    //for (i=0; i<size; i++) {
-    //   machine->mainMemory[startAddrChild+i] = machine->mainMemory[startAddrParent+i];
-    //}
-   machine->KernelPageTable = KernelPageTable;
-   //DEBUG('a', "Hi 3\n"); 
-   delete OldTable; 
-    machine->KernelPageTableSize+=shared_pages;
-    //currentThread->space->numVirtualPages += shared_pages;
-//    return size; 
-  // DEBUG('a', "Hi 4 %d\n",numVirtualPages);
+    shmTable->Attach(id, this, base);
+    (void) interrupt->SetLevel(oldLevel);
+    DEBUG('t',"Attached segment %d at VIRTUAL %d for pid = %d\n",id,base,currentThread->GetPID());
+    return base * PageSize;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::ShmDetach
+// 	Detach the segment attached at "vaddr".  Returns FALSE if there is
+//	none there.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::ShmDetach(int vaddr)
+{
+    int id;
+
+    if ((vaddr < 0) || (vaddr % PageSize != 0))
+	return FALSE;
+    id = shmTable->Find(this, vaddr / PageSize);
+    if (id < 0)
+	return FALSE;
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    DetachSegment(id, vaddr / PageSize);
+    (void) interrupt->SetLevel(oldLevel);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::DetachSegment
+// 	Detach segment "id", attached at page "base".  If this was the
+//	last process to have it attached, first save its pages, and give
+//	the segment a reference to their slots.  The pages are left
+//	unmapped, so that using them is an address error, as it is past
+//	the end of the address space; if they were the last of it, it
+//	shrinks, past any other unmapped pages before them.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::DetachSegment(int id, int base)
+{
+    ShmSegment *segment = shmTable->Segment(id);
+    TranslationEntry *entry, *resident;
+    bool saved, wrote;
+    int i;
+
+    shmTable->Detach(id, this, base);
+    for (i = 0; (segment->attached == NULL) && (i < segment->numPages); i++) {
+	entry = &KernelPageTable[base + i];
+	resident = Resident(base + i);
+	if (resident != NULL) {
+	    saved = SaveShared(resident->physicalPage, &wrote);
+	    ASSERT(saved);		// swap area full
+	}
+	ASSERT(entry->swapSlot >= 0);
+	swapDisk->ShareSlot(entry->swapSlot);
+	segment->slot[i] = entry->swapSlot;
+    }
+    for (i = base; i < base + segment->numPages; i++) {
+#ifdef USE_TLB
+	tlbManager->InvalidatePage(i);
+#endif
+	ReleasePage(i);
+	InitEntry(&KernelPageTable[i], i);
+	KernelPageTable[i].unmapped = TRUE;
+    }
+    while ((numVirtualPages > 0) 
+		&& KernelPageTable[numVirtualPages - 1].unmapped)
+	numVirtualPages--;
+    if (machine->KernelPageTable == KernelPageTable) {
+	machine->KernelPageTableSize = numVirtualPages;
+	machine->FlushTranslationCache();
+    }
+    DEBUG('t',"Detached segment %d at VIRTUAL %d for pid = %d\n",id,base,currentThread->GetPID());
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::GrowPageTable
+// 	Add "pages" pages of nothing at the end of the address space, and
+//	return the first of them.  When the page table has to be
+//	replaced, the new one has room for twice the pages, so that
+//	growing the address space again and again copies each entry only
+//	a few times on average.  Called for the running process.
+//----------------------------------------------------------------------
+
+int
+ProcessAddressSpace::GrowPageTable(int pages)
+{
+    TranslationEntry *oldTable = KernelPageTable;
+    unsigned i, first = numVirtualPages;
+
+    if (numVirtualPages + pages > tableSize) {
+	tableSize = max(2 * tableSize, numVirtualPages + pages);
+	KernelPageTable = new TranslationEntry[tableSize];
+	for (i = 0; i < numVirtualPages; i++)
+	    KernelPageTable[i] = oldTable[i];
+	delete [] oldTable;
+    }
+    for (i = first; i < first + pages; i++)
+	InitEntry(&KernelPageTable[i], i);
+    numVirtualPages += pages;
+    machine->KernelPageTable = KernelPageTable;
+    machine->KernelPageTableSize = numVirtualPages;
+    machine->FlushTranslationCache();
+    return first;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::NewSharedPage
+// 	Make "vpn" a page of shared memory, in a zeroed frame.  It is
+//	counted as a page fault.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::NewSharedPage(int vpn)
+{
+    TranslationEntry *entry = &KernelPageTable[vpn];
+    int frame = NewFrame(vpn, -1);
+
+    DEBUG('t',"assigned vpn %d to ppn %d in shm\n",vpn,frame);
+    bzero(&machine->mainMemory[frame * PageSize], PageSize);
+    machine->InvalidateDecodedFrame(frame);
+    MapPage(vpn, frame);
+    entry->shared = TRUE;
+    reverseMap->Add(frame, currentThread->GetPID(), this, vpn);
+    fifoFrames->Append(frame);
+    lruFrames->Append(frame);
+    if (pagePolicy != NULL)
+	pagePolicy->Load(frame, currentThread->GetPID(), vpn);
+    stats->numPageFaults++;
 }
 
 //----------------------------------------------------------------------
@@ -326,65 +780,302 @@ void ProcessAddressSpace::ShmAllocate(int shared_size)
 
 ProcessAddressSpace::~ProcessAddressSpace()
 {
+   if (machine->KernelPageTable == KernelPageTable)
+      machine->FlushTranslationCache();
    delete KernelPageTable;
+   if (image != NULL)
+      image->Release();
+}
+
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::MapText
+// 	Map code page "vpn" to "frame", which holds the same page for
+//	another process running the same executable.  The page is shared
+//	read-only and copy-on-write, as after a fork; the process that
+//	read it in stays the owner.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::MapText(int vpn, int frame)
+{
+    TranslationEntry *resident;
+
+    ASSERT((Resident(vpn) == NULL) && (reverseMap->Count(frame) > 0));
+    resident = MapPage(vpn, frame);
+    resident->use = FALSE;
+    resident->dirty = FALSE;
+    resident->readOnly = TRUE;
+    KernelPageTable[vpn].copyOnWrite = TRUE;
+    reverseMap->Add(frame, currentThread->GetPID(), this, vpn);
+    DEBUG('t',"Sharing code PHYSICAL %d at VIRTUAL %d with pid = %d\n",frame,vpn,currentThread->GetPID());
 }
 
+//----------------------------------------------------------------------
+// ProcessAddressSpace::MapShared
+// 	Page "vpn" is shared memory, which was saved to the swap area.
+//	If another process sharing it has faulted it back in, map the
+//	same frame, so that the two go on seeing each other's writes, and
+//	return TRUE.  Otherwise return FALSE: the page must be read in.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::MapShared(int vpn)
+{
+    TranslationEntry *entry = &KernelPageTable[vpn], *resident;
+    int frame;
+
+    ASSERT(entry->shared && (Resident(vpn) == NULL) && entry->backup);
+    frame = reverseMap->FindShared(entry->swapSlot);
+    if (frame < 0)
+	return FALSE;
+    resident = MapPage(vpn, frame);
+    resident->use = FALSE;
+    resident->dirty = FALSE;
+    reverseMap->Add(frame, currentThread->GetPID(), this, vpn);
+    if (machine->KernelPageTable != KernelPageTable)
+	machine->FlushTranslationCache();
+    machine->KernelPageTable = KernelPageTable;
+    DEBUG('t',"Sharing PHYSICAL %d at VIRTUAL %d again with pid = %d\n",frame,vpn,currentThread->GetPID());
+    return TRUE;
+}
 
 //AllocateNextPage - To allocate the next page depending on the page replacement algorithm
+//	A page saved to the swap area is read before a frame is chosen
+//	for it: the thread sleeps until the disk delivers it, and nothing
+//	can happen meanwhile to a frame it does not have yet.
+//	A code page that another process running the same executable
+//	has in memory is just mapped, and FALSE returned: nothing was
+//	read.  A code page that is read in is offered to the others.
+//	A page of uninitialized data or stack is zeroed, and FALSE
+//	returned as well; and so is a page of shared memory that another
+//	process sharing it has faulted back in (see MapShared).
+//	Neighbouring pages may be brought in with the page; see
+//	PrefetchAround.  They are read along with it, so TRUE is returned
+//	if any of them came from the executable.
 
 bool ProcessAddressSpace::AllocateNextPage(int vaddr)
 {
-    int vpn = vaddr/PageSize; 
-    //DEBUG('t',"VPN = %d Physical Page assigned = %d\n",vpn,numPagesAllocated);
-    if(numPagesAllocated < NumPhysPages){
-	if (nextunallocatedpage < NumPhysPages)                /// do remember to reverse this if block later
-	        KernelPageTable[vpn].physicalPage = nextunallocatedpage++;
-        else{
-            	int*  fp = (int *)freePages->Remove();
-                KernelPageTable[vpn].physicalPage =  *fp;
+    int vpn = vaddr/PageSize, frame;
+    TranslationEntry *resident;
+    char swapped[PageSize];
+    NoffPageKind kind = DataPage;	// a swapped page is read, too
+    bool text = (vpn < (int)numTextPages) && (KernelPageTable[vpn].backup == FALSE);
+    ASSERT(!KernelPageTable[vpn].unmapped);	// Translate says address error
+    if (text) {
+	frame = textCache->Lookup(filename, vpn);
+	if (frame >= 0) {
+	    MapText(vpn, frame);
+	    stats->numSharedText++;
+	    if (machine->KernelPageTable != KernelPageTable)
+		machine->FlushTranslationCache();
+	    machine->KernelPageTable = KernelPageTable;
+	    return PrefetchAround(vpn);
 	}
-        numPagesAllocated++;
-    }else if(rep_algo != 0){
-	DEBUG('t',"Called pace replace in Allocatenext page for vpn=%d, pid = %d\n",vpn, currentThread->GetPID());
-	KernelPageTable[vpn].physicalPage = PageReplace(-1); 	//select page for replacement depending on rep_algo
-    } 
-    else ASSERT(numPagesAllocated<NumPhysPages);
-    physical_to_virtual[KernelPageTable[vpn].physicalPage]=&KernelPageTable[vpn];
-    page_pid[KernelPageTable[vpn].physicalPage] = currentThread->GetPID();
-    DEBUG('t',"IN allocatenextpage PHYSICAL %d TO VIRTUAL %d pid = %d \n",KernelPageTable[vpn].physicalPage,physical_to_virtual[KernelPageTable[vpn].physicalPage]->virtualPage,page_pid[KernelPageTable[vpn].physicalPage]);
-
-    //DEBUG('t',"assigned physical page %d to vpn %d\n",KernelPageTable[vpn].physicalPage,vpn);
-    KernelPageTable[vpn].valid = TRUE;
-    /*if( vpn == (KernelPageTableSize - 1) ) {                 will look into it later
-        readSize = size - vpn * PageSize;                                        
-    }else readSize = PageSize;*/                  
-    //machine->KernelPageTable = KernelPageTable;
-//    DEBUG('a',"physical page = %d \n", KernelPageTable[vpn].physicalPage);
-    //machine->
-    bzero(&machine->mainMemory[(KernelPageTable[vpn].physicalPage)*PageSize], PageSize);
+    }
+    if (KernelPageTable[vpn].shared && MapShared(vpn))
+	return FALSE;
+    if (KernelPageTable[vpn].backup == TRUE) {
+	unsigned writes;
+	DEBUG('t',"Reading vpn %d of pid = %d from swap slot %d\n",vpn,currentThread->GetPID(),KernelPageTable[vpn].swapSlot);
+	do {		// a sharer may fault shared memory in, and save
+			// it again, while we wait: then read it again
+	    writes = sharedWrites;
+	    swapDisk->ReadPage(KernelPageTable[vpn].swapSlot, swapped);
+	} while (KernelPageTable[vpn].shared && (sharedWrites != writes));
+	if (KernelPageTable[vpn].shared && MapShared(vpn))
+	    return TRUE;		// or it may still have it
+    }
+    frame = NewFrame(vpn, -1);
+    resident = MapPage(vpn, frame);
+    reverseMap->Add(frame, currentThread->GetPID(), this, vpn);
+    DEBUG('t',"IN allocatenextpage PHYSICAL %d TO VIRTUAL %d pid = %d \n",frame,vpn,currentThread->GetPID());
+
+    machine->InvalidateDecodedFrame(frame);
     if(KernelPageTable[vpn].backup == FALSE){
-        NoffHeader noffH;
-        openexecutable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-        //DEBUG('t',"physical page = %d \n", KernelPageTable[vpn].physicalPage);
-        if ((noffH.noffMagic != NOFFMAGIC) && (WordToHost(noffH.noffMagic) == NOFFMAGIC))
-        SwapHeader(&noffH);
-        ASSERT(noffH.noffMagic == NOFFMAGIC); 
-        openexecutable->ReadAt(&(machine->mainMemory[KernelPageTable[vpn].physicalPage * PageSize]), PageSize, noffH.code.inFileAddr + vpn*PageSize);
-        //DEBUG('t',"VPN = %d Physical Page assigned = %d\n",vpn,numPagesAllocated);
+        kind = image->PageKind(vpn);
+        DEBUG('a',"Loading %s page %d for pid = %d\n", (kind == CodePage) ? "code" :
+			(kind == DataPage) ? "data" : "zero", vpn, currentThread->GetPID());
+        image->ReadPage(vpn, &machine->mainMemory[frame * PageSize]);
     }
     else{
 	
 	DEBUG('t',"Loading data from backup for pid = %d\n",currentThread->GetPID());
-	//LOAD from backup
-	for(int i=0;i<PageSize;i++){
-    	machine->mainMemory[KernelPageTable[vpn].physicalPage * PageSize+i] = backup[vpn*PageSize+i];
-//		DEBUG('t',"%c\n", backup[vpn*PageSize+i]);
-	}
+	bcopy(swapped, &machine->mainMemory[frame * PageSize], PageSize);
+    }
+    fifoFrames->Append(frame);
+    lruFrames->Append(frame);
+    if (pagePolicy != NULL)
+	pagePolicy->Load(frame, currentThread->GetPID(), vpn);
+    if (text) {
+	resident->readOnly = TRUE;
+	KernelPageTable[vpn].copyOnWrite = TRUE;
+	textCache->Insert(filename, vpn, frame);
     }
-    Count_ArrFIFO[KernelPageTable[vpn].physicalPage] = stats->totalTicks;
+    if (machine->KernelPageTable != KernelPageTable)
+        machine->FlushTranslationCache();
     machine->KernelPageTable = KernelPageTable;
+    bool read = PrefetchAround(vpn);
+    return (kind != ZeroPage) || read;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::PrefetchAround
+// 	Called after a fault on page "vpn" has been served.  Bring in,
+//	with it, the code and data pages within "faultAround" pages of
+//	it (-FA); and, if the faults of this process have been walking
+//	up through its pages, the next "prefetchDepth" pages (-PF),
+//	whatever they hold.  The next fault is expected at the first
+//	page past "vpn" that is not in memory.
+//
+//	Returns TRUE if any of the pages was read from the executable.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::PrefetchAround(int vpn)
+{
+    int keep = Resident(vpn)->physicalPage;
+    bool read = FALSE;
+    int i;
+
+    if (vpn == streamNext)
+	streamLength++;
+    else
+	streamLength = 0;
+    for (i = 1; i <= faultAround; i++) {
+	read = Prefetch(vpn - i, keep, FALSE) || read;
+	read = Prefetch(vpn + i, keep, FALSE) || read;
+    }
+    if (streamLength > 0)
+	for (i = 1; i <= prefetchDepth; i++)
+	    read = Prefetch(vpn + i, keep, TRUE) || read;
+    for (streamNext = vpn + 1; (streamNext < (int)numVirtualPages)
+		&& (Resident(streamNext) != NULL); streamNext++)
+	;
+    return read;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::Prefetch
+// 	Bring page "vpn" in ahead of a fault on it, if it is not in
+//	memory and comes from the executable: a code or data page, or,
+//	if "anyKind", a page that starts out as zeroes as well.  A page
+//	in the swap area is left for its own fault.  "keep" is the frame
+//	just faulted in, which must not be replaced to make room.
+//
+//	Returns TRUE if the page was read from the executable.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::Prefetch(int vpn, int keep, bool anyKind)
+{
+    TranslationEntry *entry, *resident;
+    NoffPageKind kind;
+    int frame;
+
+    if ((vpn < 0) || (vpn >= (int)numVirtualPages))
+	return FALSE;
+    entry = &KernelPageTable[vpn];
+    if ((Resident(vpn) != NULL) || entry->backup || entry->unmapped)
+	return FALSE;
+    kind = image->PageKind(vpn);
+    if ((kind == ZeroPage) && !anyKind)
+	return FALSE;
+    if (vpn < (int)numTextPages) {
+	frame = textCache->Lookup(filename, vpn);
+	if (frame >= 0) {		// nothing to read
+	    MapText(vpn, frame);
+	    stats->numSharedText++;
+	    return FALSE;
+	}
+    }
+
+    if ((pffInterval > 0) && (ResidentPages() >= quota))
+	return FALSE;			// the process is at its quota
+    frame = frameAllocator->Allocate();
+    if ((frame < 0) && (rep_algo != 0)) {
+	DEBUG('t',"Called page replace in prefetch for vpn=%d, pid = %d\n",vpn, currentThread->GetPID());
+	frame = PageReplace(keep);
+    }
+    if (frame < 0)
+	return FALSE;			// no room, and no replacement
+
+    resident = MapPage(vpn, frame);
+    reverseMap->Add(frame, currentThread->GetPID(), this, vpn);
+    resident->use = FALSE;
+    resident->dirty = FALSE;
+    entry->prefetched = TRUE;
+    machine->InvalidateDecodedFrame(frame);
+    image->ReadPage(vpn, &machine->mainMemory[frame * PageSize]);
+    fifoFrames->Append(frame);
+    lruFrames->Append(frame);
+    if (pagePolicy != NULL)
+	pagePolicy->Load(frame, currentThread->GetPID(), vpn);
+    if (vpn < (int)numTextPages) {
+	resident->readOnly = TRUE;
+	entry->copyOnWrite = TRUE;
+	textCache->Insert(filename, vpn, frame);
+    }
+    stats->numPrefetches++;
+    DEBUG('t',"Prefetched vpn %d into PHYSICAL %d for pid = %d\n",vpn,frame,currentThread->GetPID());
+    return (kind != ZeroPage);
+}
+//----------------------------------------------------------------------
+// ProcessAddressSpace::CopyOnWrite
+// 	Called on a write to a page this process shares copy-on-write 
+//	after a fork.  Give the process its own copy of the page at 
+//	"vaddr"; or, if nobody else maps the frame any more, just make
+//	it writable.
+//
+//	Returns TRUE if the page had to be copied.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::CopyOnWrite(int vaddr)
+{
+    int vpn = vaddr/PageSize;
+    TranslationEntry *entry = &KernelPageTable[vpn];
+    TranslationEntry *resident = Resident(vpn);
+    int oldFrame, newFrame = -1;
+    bool use, dirty;
+
+    ASSERT((resident != NULL) && entry->copyOnWrite);
+    oldFrame = resident->physicalPage;
+#ifdef USE_TLB
+    tlbManager->InvalidatePage(vpn);
+#endif
+    resident->readOnly = FALSE;
+    entry->copyOnWrite = FALSE;
+    if (reverseMap->Count(oldFrame) == 1) {	// the others are gone
+	textCache->Remove(oldFrame);		// no longer the program's code
+	return FALSE;
+    }
+
+    newFrame = NewFrame(vpn, oldFrame);	// not the one we copy from
+
+    for (int j = 0; j < PageSize; j++)
+	machine->mainMemory[newFrame*PageSize+j] = machine->mainMemory[oldFrame*PageSize+j];
+    machine->InvalidateDecodedFrame(newFrame);
+
+    DropMapping(oldFrame, this, vpn);
+    resident = Resident(vpn);
+    use = resident->use;
+    dirty = resident->dirty;
+    UnmapPage(vpn);
+    resident = MapPage(vpn, newFrame);	// the same page, in the new frame
+    resident->use = use;
+    resident->dirty = dirty;
+    reverseMap->Add(newFrame, currentThread->GetPID(), this, vpn);
+    fifoFrames->Append(newFrame);
+    lruFrames->Append(newFrame);
+    if (pagePolicy != NULL)
+	pagePolicy->Load(newFrame, currentThread->GetPID(), vpn);
+    ArrCLRU_s[newFrame] = 1;
+    stats->numCopyOnWrites++;
+    DEBUG('t',"Copied PHYSICAL %d to %d for VIRTUAL %d pid = %d\n",oldFrame,newFrame,vpn,currentThread->GetPID());
     return TRUE;
 }
+
 //----------------------------------------------------------------------
 // ProcessAddressSpace::InitUserModeCPURegisters
 // 	Set the initial values for the user-level register set.
@@ -417,26 +1108,76 @@ ProcessAddressSpace::InitUserModeCPURegisters()
 }
 //---------------------------------------------------------------------
 //ProcessAddressSpace::Free_Exiting_Pages()
-//Free all pages belonging to the thread exiting currently
-//
+//Free all pages belonging to the thread exiting currently,
+//and its slots in the swap area; a frame other processes still map
+//is left to them.  The segments it has attached are detached first.
 //--------------------------------------------------------------------
 void ProcessAddressSpace::Free_Exiting_Pages()
 {
     int i=0;
-    int * temp;
+    ShmAttachment *attachment, *next;
+    if (pageTrace != NULL)
+	pageTrace->Release(currentThread->GetPID());
+    for (int id = 0; id < MaxShmSegments; id++) {
+	if (shmTable->Segment(id) == NULL)
+	    continue;
+	for (attachment = shmTable->Attachments(id); attachment != NULL; attachment = next) {
+	    next = attachment->next;
+	    if (attachment->space == this)
+		DetachSegment(id, attachment->base);
+	}
+    }
     for(i=0;i<numVirtualPages;i++)
-    {
-	temp = new int(KernelPageTable[i].physicalPage);
-	if(KernelPageTable[i].valid && !KernelPageTable[i].shared){
-	    numPagesAllocated--;
-	    freePages->Append((void*)temp);
-            physical_to_virtual[KernelPageTable[i].physicalPage]=NULL;
-
-	    // Remove the entry from the hashmap
-	    
+	ReleasePage(i);
+    if (pagePolicy != NULL)
+	pagePolicy->Forget(currentThread->GetPID());
+    if (image != NULL) {		// the program is done with the file
+	image->Release();
+	image = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::ReleasePage
+// 	Give up the frame of page "vpn", if it has one, and its swap slot,
+//	if it has one.  A frame other processes still map is left to
+//	them; if the last of them is leaving a page of shared memory that
+//	the others read from the swap area, it is saved there first.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::ReleasePage(int vpn)
+{
+    TranslationEntry *entry = &KernelPageTable[vpn];
+    TranslationEntry *resident = Resident(vpn);
+    int frame;
+    bool wrote;
+
+    if (resident != NULL) {
+	frame = resident->physicalPage;
+	AccountPrefetch(entry, resident);
+	if (entry->shared && (reverseMap->Count(frame) == 1)
+		    && (entry->swapSlot >= 0)
+		    && swapDisk->IsShared(entry->swapSlot))
+	    SaveShared(frame, &wrote);	// the others read it from there
+	DropMapping(frame, this, vpn);
+	UnmapPage(vpn);
+	if (reverseMap->Count(frame) == 0) {	// nobody else maps it
+	    frameAllocator->Free(frame);
+	    fifoFrames->Remove(frame);
+	    lruFrames->Remove(frame);
+	    if (pagePolicy != NULL)
+		pagePolicy->Free(frame);
+	    textCache->Remove(frame);
 	}
     }
+    if (entry->swapSlot >= 0) {
+	swapDisk->ReleaseSlot(entry->swapSlot);
+	entry->swapSlot = -1;
+	entry->backup = FALSE;
+    }
 }
+
 //---------------------------------------------------------------------
 //int ProcessAddressSpace::PageReplace()
 //Returns the physical page number which is switched out of main memory
@@ -448,53 +1189,26 @@ int ProcessAddressSpace::PageReplace(int parent){
     if (rep_algo == 1)
     {
 	   x=Random()%NumPhysPages;
-	   while (physical_to_virtual[x]->shared == TRUE || parent==x)
+	   stats->numFramesExamined++;
+	   while (parent==x)
        {
 		  x=Random()%NumPhysPages;
+		  stats->numFramesExamined++;
 	   }
 
     }
     else if (rep_algo == 2)
     {
-          
-        x = -1;
-        int min = stats->totalTicks;
-        for(int index = 0;index<NumPhysPages;index++)
-        {
-            if(physical_to_virtual[index]->shared == TRUE || parent==index)
-                continue;
-            else
-            {
-                if(Count_ArrFIFO[index] < min)
-                {
-                    min = Count_ArrFIFO[index];
-                    x = index;
-                }
-            }
-        }
+        x = fifoFrames->First(parent);
         ASSERT(x >= 0);
+        stats->numFramesExamined++;
 
     }
     else if (rep_algo == 3)
     {
-        x = -1;
-        //DEBUG('a',"Hello");
-        int min = stats->totalTicks;
-        for(int index = 0;index<NumPhysPages;index++)
-        {
-            DEBUG('a'," Time is %d for index %d with mint %d \n",Count_ArrLRU[index],index,min);
-            if(physical_to_virtual[index]->shared == TRUE || parent==index)
-                continue;
-            else
-            {
-                if(Count_ArrLRU[index] <= min)
-                {
-                    min = Count_ArrLRU[index];
-                    x = index;
-                }
-            }
-        }
+        x = lruFrames->First(parent);
         ASSERT(x >= 0);
+        stats->numFramesExamined++;
     }
     else if (rep_algo == 4)
     {
@@ -506,7 +1220,8 @@ int ProcessAddressSpace::PageReplace(int parent){
         for(int ind = clockindex; ind<=finindex; ind++)
         {
             index = ind%NumPhysPages;
-            if(physical_to_virtual[index]->shared == TRUE || parent==index)
+            stats->numFramesExamined++;
+            if(parent==index)
                 continue;
             else
             {
@@ -524,26 +1239,261 @@ int ProcessAddressSpace::PageReplace(int parent){
         ArrCLRU_s[x] = 1;
         clockindex = x;
     }
-
-    physical_to_virtual[x]->valid = FALSE;
-    int pid = page_pid[x];
-   if (physical_to_virtual[x]->dirty==TRUE)
-   {
-        physical_to_virtual[x]->backup = TRUE;
-        DEBUG('t',"Setting backup to true for pid = %d, vpn = %d\n",pid,physical_to_virtual[x]->virtualPage);
-       for(int j = 0 ; j<PageSize;j++ )
-       {
-        threadArray[pid]->space->backup[physical_to_virtual[x]->virtualPage*PageSize+j] = machine->mainMemory[x*PageSize+j];
-        //DEBUG('t',"Writing Backup memeory %c\n",machine->mainMemory[x*PageSize+j]);
-       }
-       physical_to_virtual[x]->dirty = FALSE;
+    else
+    {
+        x = pagePolicy->Victim(parent);
+        ASSERT(x >= 0);
+        stats->numFramesExamined++;
     }
-        //DEBUG('t'," In REPLACE PHYSICAL %d TO VIRTUAL %d pid = %d \n",x,physical_to_virtual[x]->virtualPage,page_pid[x]);
 
-   DEBUG('t',"Replaced page from pid = %d vpn = %d PhysPageNum = %d\n",pid,physical_to_virtual[x]->virtualPage,x);
+    ReclaimFrame(x);
    return x;
 
 }
+//----------------------------------------------------------------------
+// ProcessAddressSpace::NewFrame
+// 	Return a frame for page "vpn" of this process: a free one if there
+//	is any, else one taken from another page by the replacement policy,
+//	other than "parent".  There must be a policy, then.
+//
+//	Under the page-fault-frequency policy (-PFF), a process whose
+//	private pages already fill its quota gets no more frames: the
+//	frame of one of its own pages is taken for a private page it does
+//	not have in memory yet.  A copy-on-write copy replaces a page it
+//	has, and shared memory does not count against the quota.
+//----------------------------------------------------------------------
+
+int
+ProcessAddressSpace::NewFrame(int vpn, int parent)
+{
+    TranslationEntry *entry = &KernelPageTable[vpn];
+    int frame = -1;
+
+    if ((pffInterval > 0) && (Resident(vpn) == NULL) && !entry->shared
+		&& (ResidentPages() >= quota))
+	frame = OwnVictim(parent);
+    if (frame >= 0) {
+	DEBUG('t',"At quota %d for pid = %d\n",quota,currentThread->GetPID());
+	ReclaimFrame(frame);
+	stats->numQuotaReplacements++;
+	return frame;
+    }
+    frame = frameAllocator->Allocate();
+    if (frame < 0) {
+	ASSERT(rep_algo != 0);		// out of memory, and nothing replaces
+	DEBUG('t',"Called page replace for pid = %d\n", currentThread->GetPID());
+	frame = PageReplace(parent);
+    }
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::OwnVictim
+// 	Return the frame to replace when this process is at its quota: of
+//	its private pages that no other process maps, the one loaded first
+//	(-R 2), or else the one used least recently, other than "parent".
+//	Returns -1 if none of them can go.
+//----------------------------------------------------------------------
+
+int
+ProcessAddressSpace::OwnVictim(int parent)
+{
+    FrameList *order = (rep_algo == 2) ? fifoFrames : lruFrames;
+    FrameMapping *mapping;
+    int frame;
+
+    for (frame = order->First(parent); frame != -1; frame = order->Next(frame)) {
+	stats->numFramesExamined++;
+	mapping = reverseMap->Mappings(frame);
+	if ((frame != parent) && (mapping != NULL) && (mapping->space == this)
+		&& (reverseMap->Count(frame) == 1) && !mapping->Entry()->shared)
+	    return frame;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::ResidentPages
+// 	Return how many pages of this process, other than shared memory,
+//	are in memory.
+//----------------------------------------------------------------------
+
+int
+ProcessAddressSpace::ResidentPages()
+{
+    int resident = 0;
+
+    for (unsigned i = 0; i < numVirtualPages; i++)
+	if ((Resident(i) != NULL) && !KernelPageTable[i].shared)
+	    resident++;
+    return resident;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::PageOut
+// 	Take the frame of page "vpn", a private page of this process,
+//	away from it: save the page to the swap area if it has changed,
+//	and put the frame back in the free pool.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::PageOut(int vpn)
+{
+    TranslationEntry *entry = &KernelPageTable[vpn];
+    TranslationEntry *resident = Resident(vpn);
+    int x;
+
+    ASSERT((resident != NULL) && !entry->shared && !entry->copyOnWrite);
+    x = resident->physicalPage;
+    ASSERT(reverseMap->Count(x) == 1);
+    machine->InvalidateDecodedFrame(x);
+    fifoFrames->Remove(x);
+    lruFrames->Remove(x);
+    if (pagePolicy != NULL)
+	pagePolicy->Evict(x);		// it may be back: keep its history
+    SaveAndUnmap(currentThread->GetPID(), this, vpn, x);
+    reverseMap->Clear(x);
+    frameAllocator->Free(x);
+    DEBUG('t',"Paged out vpn %d from PHYSICAL %d for pid = %d\n",vpn,x,currentThread->GetPID());
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::AdjustResidentSet
+// 	Called on each page fault, when the page-fault-frequency policy
+//	is on (-PFF).  Faults are timed in instructions executed by the
+//	process.  If it ran "pffInterval" instructions or more since its
+//	last fault, its working set has shrunk: the private pages it has
+//	not referenced since then are paged out, and its quota is cut to
+//	what is left, plus the page it is faulting on.  Otherwise it is
+//	short of frames, and its quota grows to make room for the page.
+//	Either way, the use bits are cleared for the next interval.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::AdjustResidentSet()
+{
+    unsigned now = currentThread->GetInstructionCount();
+    bool trim = ((now - lastFault) >= (unsigned)pffInterval);
+    TranslationEntry *entry, *translation;
+    int resident = 0;
+    unsigned i;
+
+    for (i = 0; i < numVirtualPages; i++) {
+	entry = &KernelPageTable[i];
+	translation = Resident(i);
+	if ((translation == NULL) || entry->shared)
+	    continue;
+	if (trim && !translation->use && !entry->copyOnWrite) {
+	    PageOut(i);
+	    stats->numPagesTrimmed++;
+	    continue;
+	}
+	if (translation->use)
+	    AccountPrefetch(entry, translation);	// before the evidence goes
+	translation->use = FALSE;
+	resident++;
+    }
+    if (trim)
+	quota = resident + 1;
+    else
+	quota = max(quota, resident + 1);
+    quota = max(quota, PffMinQuota);
+    quota = min(quota, NumPhysPages);
+    lastFault = now;
+    DEBUG('t',"Resident set of pid = %d: %d pages, quota %d\n",currentThread->GetPID(),resident,quota);
+}
+
+//----------------------------------------------------------------------
+// RunningDemand
+// 	Return the sum of the quotas of the processes that load control
+//	has not swapped out, and put how many there are in "running".
+//----------------------------------------------------------------------
+
+static int
+RunningDemand (int *running)
+{
+    ProcessAddressSpace *space;
+    int demand = 0;
+    unsigned i;
+
+    *running = 0;
+    for (i = 0; i < thread_index; i++) {
+	if (exitThreadArray[i] || (threadArray[i] == NULL)
+				|| (threadArray[i]->space == NULL))
+	    continue;
+	space = threadArray[i]->space;
+	if (space->IsSuspended())
+	    continue;
+	demand += space->GetQuota();
+	(*running)++;
+    }
+    return demand;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::MustSuspend
+// 	Load control: return TRUE if the quotas of the processes that are
+//	not swapped out add up to more than there is memory, and this
+//	one, which is faulting, should step aside.  The last process
+//	running is never suspended, and nor is one back from a suspension
+//	for less than SuspendTicks.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::MustSuspend()
+{
+    int running, demand;
+
+    if (stats->totalTicks < resumedAt + SuspendTicks)
+	return FALSE;
+    demand = RunningDemand(&running);
+    return (demand > NumPhysPages) && (running > 1);
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::MayResume
+// 	Return TRUE if this process, swapped out, fits in memory with the
+//	ones running, or nothing else is running.
+//----------------------------------------------------------------------
+
+bool
+ProcessAddressSpace::MayResume()
+{
+    int running, demand = RunningDemand(&running);
+
+    ASSERT(suspended);
+    return (running == 0) || (demand + quota <= NumPhysPages);
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::Suspend/Resume
+// 	Swap the process out, giving up all its private frames, until
+//	there is room for it again; it keeps its quota, and gets its
+//	pages back by faulting on them.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::Suspend()
+{
+    unsigned i;
+
+    for (i = 0; i < numVirtualPages; i++)
+	if ((Resident(i) != NULL) && !KernelPageTable[i].shared
+				&& !KernelPageTable[i].copyOnWrite)
+	    PageOut(i);
+    suspended = TRUE;
+    stats->numSuspensions++;
+    DEBUG('t',"Suspended pid = %d, quota %d\n",currentThread->GetPID(),quota);
+}
+
+void
+ProcessAddressSpace::Resume()
+{
+    suspended = FALSE;
+    resumedAt = stats->totalTicks;
+    DEBUG('t',"Resumed pid = %d, quota %d\n",currentThread->GetPID(),quota);
+}
+
 //----------------------------------------------------------------------
 // ProcessAddressSpace::SaveContextOnSwitch
 // 	On a context switch, save any machine state, specific
@@ -560,13 +1510,21 @@ void ProcessAddressSpace::SaveContextOnSwitch()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	which process's pages to look for in the inverted page table.
+//	With a TLB, give it our ASID too; entries of other address
+//	spaces stay in the TLB, but do not match.
 //----------------------------------------------------------------------
 
 void ProcessAddressSpace::RestoreContextOnSwitch() 
 {
     machine->KernelPageTable = KernelPageTable;
     machine->KernelPageTableSize = numVirtualPages;
+    machine->spaceId = pid;
+    machine->FlushTranslationCache();
+#ifdef USE_TLB
+    tlbManager->SwitchTo(&asid, &asidGeneration);
+#endif
 }
 
 unsigned
@@ -580,3 +1538,57 @@ ProcessAddressSpace::GetPageTable()
 {
    return KernelPageTable;
 }
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::Resident
+// 	Return the translation of page "vpn", which holds its frame and
+//	its use and dirty bits, or NULL if it is not in memory.  Under
+//	-IPT that is the entry of the inverted page table, the only record
+//	of the pages in memory; otherwise it is the page table entry.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+ProcessAddressSpace::Resident(int vpn)
+{
+    if (machine->invertedTable != NULL)
+	return machine->invertedTable->Find(pid, vpn);
+    return KernelPageTable[vpn].valid ? &KernelPageTable[vpn] : NULL;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::MapPage
+// 	Page "vpn", which is not in memory, is in "frame" now: enter its
+//	translation, in the page table or, under -IPT, in the inverted
+//	page table, and return it.  The caller sets its bits.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+ProcessAddressSpace::MapPage(int vpn, int frame)
+{
+    TranslationEntry *entry = &KernelPageTable[vpn];
+
+    if (machine->invertedTable != NULL)
+	return machine->invertedTable->Insert(pid, vpn, frame);
+    entry->physicalPage = frame;
+    entry->valid = TRUE;
+    return entry;
+}
+
+//----------------------------------------------------------------------
+// ProcessAddressSpace::UnmapPage
+// 	Page "vpn" is not in memory any more: drop its translation.  What
+//	was in the frame has been saved, if it had to be, so the page is
+//	clean; and it is writable when it is loaded again.
+//----------------------------------------------------------------------
+
+void
+ProcessAddressSpace::UnmapPage(int vpn)
+{
+    if (machine->invertedTable != NULL)
+	machine->invertedTable->Remove(pid, vpn);
+    else {
+	KernelPageTable[vpn].valid = FALSE;
+	KernelPageTable[vpn].readOnly = FALSE;
+	KernelPageTable[vpn].dirty = FALSE;
+    }
+}
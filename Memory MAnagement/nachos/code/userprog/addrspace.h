@@ -16,36 +16,117 @@
 #include "copyright.h"
 #include "filesys.h"
 
+class NoffImage;
+
 #define UserStackSize		1024 	// increase this as necessary!
+#define PffMinQuota		4	// Fewest frames a process is allowed
+					// under the page-fault-frequency policy
+#define SuspendTicks		10000	// How long load control swaps a
+					// process out for, and how long it is
+					// then left alone
+#define CleanerBatch		4	// Most pages the page cleaner writes
+					// each time it runs
 
 class ProcessAddressSpace {
   public:
-    ProcessAddressSpace(OpenFile *executable);	// Create an address space,
-					// initializing it with the program
-					// stored in the file "executable"
+    ProcessAddressSpace(OpenFile *executable, char *name, int thread_pid);
+					// Create an address space for
+					// process "thread_pid", initializing
+					// it with the program stored in the
+					// file "executable", opened as "name"
 
     ProcessAddressSpace (ProcessAddressSpace *parentSpace,int child_pid);	// Used by fork
 
     ~ProcessAddressSpace();			// De-allocate an address space
-    char* backup;
     void InitUserModeCPURegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
-    void Free_Exiting_Pages();
+    void Free_Exiting_Pages();		// Give up the frames, swap slots
+					// and executable
     int PageReplace(int parent);
     void SaveContextOnSwitch();			// Save/restore address space-specific
     void RestoreContextOnSwitch();		// info on a context switch
-    bool AllocateNextPage(int vaddr);
+    bool AllocateNextPage(int vaddr);	// Map the page at "vaddr"; TRUE
+					// if it had to be read in
+    bool CopyOnWrite(int vaddr);	// Called on a write to a page 
+					// shared since a fork
+    void AdjustResidentSet();		// Grow or trim the resident set on
+					// a fault (-PFF)
+    bool MustSuspend();			// Too many pages wanted: should this
+					// process be swapped out?
+    bool MayResume();			// Is there room to let it back in?
+    void Suspend();			// Swap it out
+    void Resume();			// It is running again
+    bool IsSuspended() { return suspended; }
+    int GetQuota() { return quota; }
     void ShmAllocate(int shared_size);
+    int ShmAttach(int id);		// Attach segment "id" (see
+					// shmtable.h); return its address,
+					// or -1 if there is no such segment
+    bool ShmDetach(int vaddr);		// Detach the segment attached at
+					// "vaddr"; FALSE if there is none
     unsigned GetNumPages();
-    OpenFile* openexecutable;
     TranslationEntry* GetPageTable();
+    TranslationEntry *Resident(int vpn);	// The translation of "vpn",
+					// NULL if it is not in memory
+    TranslationEntry *MapPage(int vpn, int frame);	// "vpn" is in
+					// "frame" now: enter its translation,
+					// and return it
+    void UnmapPage(int vpn);		// It is not in memory any more
     char filename[100];   //Used to open executable
   private:
+    bool PrefetchAround(int vpn);	// Bring in pages near "vpn", after
+					// a fault on it
+    bool Prefetch(int vpn, int keep, bool anyKind);	// Bring in "vpn",
+					// if it is cheap to
+    int GrowPageTable(int pages);	// Add "pages" pages at the end of
+					// the address space; return the
+					// first of them
+    void NewSharedPage(int vpn);	// Give "vpn" a zeroed frame of
+					// shared memory
+    void DetachSegment(int id, int base);	// Detach segment "id",
+					// attached at page "base"
+    void ReleasePage(int vpn);		// Give up the frame and swap slot
+					// of "vpn"
+    int NewFrame(int vpn, int parent);	// A free frame for "vpn", or one
+					// replaced, other than "parent"
+    int OwnVictim(int parent);		// The frame of its own to replace
+					// when it is at its quota (-PFF)
+    int ResidentPages();		// Private pages in memory
+    void PageOut(int vpn);		// Give up the frame of page "vpn"
+    void MapText(int vpn, int frame);	// Map code page "vpn" to "frame",
+					// shared with the other processes
+					// running the same executable
+    bool MapShared(int vpn);		// Map shared memory page "vpn" to
+					// the frame another process faulted
+					// it into, if there is one
+    NoffImage *image;			// The executable, shared by all the
+					// processes running it
     TranslationEntry *KernelPageTable;	// Assume linear page table translation
-					// for now!
+					// for now!  Under -IPT, it only says
+					// where each page is kept when it
+					// is not in memory; the inverted
+					// page table has the pages that are
+    int pid;				// The process it belongs to
     unsigned int numVirtualPages;		// Number of pages in the virtual 
 					// address space
+    unsigned int tableSize;		// Entries there is room for in
+					// KernelPageTable
+    int streamNext, streamLength;	// Where the next fault of a
+					// sequential sweep would be, and how
+					// many faults in a row were there
+    int quota;				// Frames it is entitled to (-PFF)
+    unsigned lastFault;			// Instructions it had run at its
+					// last page fault
+    bool suspended;			// Swapped out by load control
+    int resumedAt;			// When it was last let back in
+    unsigned int numTextPages;		// Pages holding nothing but code;
+					// they can be shared (see textcache.h)
+    int asid;				// Tags its TLB entries (USE_TLB)
+    unsigned asidGeneration;		// When it got "asid"; 0 for never
    // int Count_Arr[numVirtualPages];
 };
 
+extern void CleanPages();		// Write back dirty pages about to be
+					// replaced (-PC); see addrspace.cc
+
 #endif // ADDRSPACE_H
@@ -83,6 +83,22 @@ void
 ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
+#ifdef USE_TLB
+    if (which == PageFaultException) {	// like the MIPS's own TLB miss
+					// vector: most misses only need a
+					// refill, so do that before anything
+					// else
+	IntStatus oldLevel = interrupt->SetLevel(IntOff);
+	ExceptionType miss = tlbManager->Refill(machine->registers[BadVAddrReg]);
+	(void) interrupt->SetLevel(oldLevel);
+	if (miss == NoException)
+	    return;			// retry the access
+	if (miss == AddressErrorException) {
+	    ExceptionHandler(miss);	// not in the address space
+	    return;
+	}
+    }				// else a real page fault
+#endif
     int memval, vaddr, printval, tempval, exp,shared_size,shared_vaddr; //shared_size == the amount of shared memory required, shared_vaddr == starting address
     unsigned printvalus;	// Used for printing in hex
     if (!initializedConsoleSemaphores) {
@@ -100,19 +116,44 @@ ExceptionHandler(ExceptionType which)
     unsigned sleeptime;		// Used by SysCall_Sleep
     if (which == PageFaultException){
 	//printf("in page fault exception handler\n");
-	stats->numPageFaults++;
 	IntStatus oldLevel = interrupt->SetLevel(IntOff); // disable interrupts
+	if (pffInterval > 0) {
+	    currentThread->space->AdjustResidentSet();
+	    if (currentThread->space->MustSuspend()) {	// load control
+		currentThread->space->Suspend();
+		(void) interrupt->SetLevel(oldLevel);
+		do		// until there is room for it again
+		    currentThread->SortedInsertInWaitQueue(stats->totalTicks+SuspendTicks);
+		while (!currentThread->space->MayResume());
+		currentThread->space->Resume();
+		return;			// the access faults again, and is
+					// counted then
+	    }
+	}
+	stats->numPageFaults++;
         /*if (rep_algo == 0){
 	        printf("Page Fault when there is no demand paging, shouldn't have been so");
 		ASSERT(FALSE);
 	}else{*/
 		DEBUG('a',"over success variable %d\n", machine->registers[BadVAddrReg]);
-		bool success = currentThread->space->AllocateNextPage(machine->registers[BadVAddrReg]);
+		int vpn = machine->registers[BadVAddrReg]/PageSize;
+		bool swapped = currentThread->space->GetPageTable()[vpn].backup;
+		bool loaded = currentThread->space->AllocateNextPage(machine->registers[BadVAddrReg]);
 		DEBUG('a',"succeeded");
-		ASSERT(success);
 	//}
 	(void) interrupt->SetLevel(oldLevel);  //set interrupt or exception status
-	currentThread->SortedInsertInWaitQueue(stats->totalTicks+1000); //put it in sleep
+	if (loaded && !swapped)	// a swap-in has already waited for the disk,
+				// and a shared code page or a zero-filled
+				// page needs no reading
+	    currentThread->SortedInsertInWaitQueue(stats->totalTicks+1000); //put it in sleep
+    }
+    else if (which == ReadOnlyException) {
+	// A write to a page shared copy-on-write since a fork
+	IntStatus oldLevel = interrupt->SetLevel(IntOff); // disable interrupts
+	bool copied = currentThread->space->CopyOnWrite(machine->registers[BadVAddrReg]);
+	(void) interrupt->SetLevel(oldLevel);
+	if (copied)
+	    currentThread->SortedInsertInWaitQueue(stats->totalTicks+1000); //the copy takes as long as fork's used to
     }
     else if ((which == SyscallException) && (type == SysCall_Halt)) {
 	DEBUG('a', "Shutdown, initiated by user program.\n");
@@ -135,16 +176,23 @@ ExceptionHandler(ExceptionType which)
     else if ((which == SyscallException) && (type == SysCall_Exec)) {
        // Copy the executable name into kernel space
        vaddr = machine->ReadRegister(4);
-       machine->ReadMem(vaddr, 1, &memval);
+       while (!machine->ReadMem(vaddr, 1, &memval))
+          ;	// the page faulted (or missed in the TLB): read it again
        i = 0;
        while ((*(char*)&memval) != '\0') {
           buffer[i] = (*(char*)&memval);
           i++;
           vaddr++;
-          machine->ReadMem(vaddr, 1, &memval);
+          while (!machine->ReadMem(vaddr, 1, &memval))
+             ;
        }
        buffer[i] = (*(char*)&memval);
-       LaunchUserProcess(buffer);
+       LaunchUserProcess(buffer);	// only returns if there is no such file
+       machine->WriteRegister(2, -1);
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
     }
     else if ((which == SyscallException) && (type == SysCall_Join)) {
        waitpid = machine->ReadRegister(4);
@@ -233,12 +281,14 @@ ExceptionHandler(ExceptionType which)
     }
     else if ((which == SyscallException) && (type == SysCall_PrintString)) {
        vaddr = machine->ReadRegister(4);
-       machine->ReadMem(vaddr, 1, &memval);
+       while (!machine->ReadMem(vaddr, 1, &memval))
+          ;	// the page faulted (or missed in the TLB): read it again
        while ((*(char*)&memval) != '\0') {
           writeDone->P() ;
           console->PutChar(*(char*)&memval);
           vaddr++;
-          machine->ReadMem(vaddr, 1, &memval);
+          while (!machine->ReadMem(vaddr, 1, &memval))
+             ;
        }
        // Advance program counters.
        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
@@ -331,6 +381,28 @@ ExceptionHandler(ExceptionType which)
        machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
        machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
        machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    }
+    else if ((which == SyscallException) && (type == SysCall_ShmGet)) {
+       machine->WriteRegister(2, shmTable->Get(machine->ReadRegister(4),
+			divRoundUp(machine->ReadRegister(5), PageSize)));
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    }
+    else if ((which == SyscallException) && (type == SysCall_ShmAt)) {
+       machine->WriteRegister(2, currentThread->space->ShmAttach(machine->ReadRegister(4)));
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
+    }
+    else if ((which == SyscallException) && (type == SysCall_ShmDt)) {
+       machine->WriteRegister(2, currentThread->space->ShmDetach(machine->ReadRegister(4)) ? 0 : -1);
+       // Advance program counters.
+       machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+       machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+       machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg)+4);
     } else {
 	printf("Unexpected user mode exception %d %d\n", which, type);
 	ASSERT(FALSE);
@@ -0,0 +1,126 @@
+// frameallocator.cc
+//	Routines to hand out physical frames, and take them back.
+//	See frameallocator.h for the overall design.
+//
+//	All of these are called with interrupts off, from the page fault
+//	handler, address space creation, or thread exit.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "frameallocator.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// CurrentCPU
+// 	Return the CPU the running thread is on; frames are kept for it.
+//----------------------------------------------------------------------
+
+static int
+CurrentCPU()
+{
+    return (currentThread != NULL) ? currentThread->GetCPU() : 0;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::FrameAllocator
+// 	Initialize the pool: every frame is free.  They are stacked so that
+//	they are handed out lowest first.
+//
+//	"nframes" is the number of physical frames.
+//----------------------------------------------------------------------
+
+FrameAllocator::FrameAllocator(int nframes)
+{
+    numFrames = numFree = top = nframes;
+    inUse = new BitMap(nframes);
+    freeStack = new int[nframes];
+    for (int i = 0; i < nframes; i++)
+	freeStack[i] = nframes - 1 - i;
+    cacheSize = 0;
+    for (int i = 0; i < MAX_CPU_COUNT; i++) {
+	cache[i] = NULL;
+	cached[i] = 0;
+    }
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    for (int i = 0; i < MAX_CPU_COUNT; i++)
+	delete [] cache[i];
+    delete [] freeStack;
+    delete inUse;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::SetCacheSize
+// 	Let each CPU keep up to "size" of the frames it frees, for its
+//	own next allocations.  Must be called before any frame is taken.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::SetCacheSize(int size)
+{
+    ASSERT((size >= 0) && (numFree == numFrames) && (cacheSize == 0));
+    if (size == 0)
+	return;
+    cacheSize = size;
+    for (int i = 0; i < MAX_CPU_COUNT; i++)
+	cache[i] = new int[size];
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Allocate
+// 	Take a free frame: one the running CPU kept if it has any, else
+//	the top of the shared stack, else one another CPU kept.
+//
+//	Returns the frame, or -1 if all of them are in use.
+//----------------------------------------------------------------------
+
+int
+FrameAllocator::Allocate()
+{
+    int cpu = CurrentCPU(), frame;
+
+    if (cached[cpu] > 0) {
+	frame = cache[cpu][--cached[cpu]];
+	stats->numFrameCacheHits++;
+    } else if (top > 0)
+	frame = freeStack[--top];
+    else {
+	for (cpu = 0; (cpu < MAX_CPU_COUNT) && (cached[cpu] == 0); cpu++)
+	    ;
+	if (cpu == MAX_CPU_COUNT)
+	    return -1;
+	frame = cache[cpu][--cached[cpu]];
+    }
+    ASSERT(!inUse->Test(frame));
+    inUse->Mark(frame);
+    numFree--;
+    stats->numFrameAllocations++;
+    stats->numFramesExamined++;
+    DEBUG('t', "Allocated PHYSICAL %d, %d free\n", frame, numFree);
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// FrameAllocator::Free
+// 	Give "frame" back: to the running CPU, if it has room for it,
+//	else to the shared stack.  Nothing may map it any more.
+//----------------------------------------------------------------------
+
+void
+FrameAllocator::Free(int frame)
+{
+    int cpu = CurrentCPU();
+
+    ASSERT((frame >= 0) && (frame < numFrames) && inUse->Test(frame));
+    inUse->Clear(frame);
+    numFree++;
+    if (cached[cpu] < cacheSize)
+	cache[cpu][cached[cpu]++] = frame;
+    else
+	freeStack[top++] = frame;
+}
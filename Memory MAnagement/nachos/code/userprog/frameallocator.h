@@ -0,0 +1,53 @@
+// frameallocator.h
+//	Data structures to keep track of which physical frames are free.
+//
+//	The free frames are kept on a stack, so that taking one and giving
+//	one back each take a constant time, however many frames there are.
+//	A bitmap records which frames are in use, to catch a frame that is
+//	freed twice, or handed out while some process still has it.
+//
+//	Optionally (-FC), each CPU keeps a few of the frames it freed to
+//	itself, and is given those first: a frame a CPU has just used is
+//	likely to still be in its cache.  A CPU with none left takes from
+//	the shared stack, and when that is empty too, from the others.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "bitmap.h"
+#include "stats.h"
+
+// The following class defines the pool of free physical frames.
+
+class FrameAllocator {
+  public:
+    FrameAllocator(int nframes);	// Every frame is free
+    ~FrameAllocator();
+
+    int Allocate();			// Take a free frame; -1 if there
+					// is none
+    void Free(int frame);		// Give "frame" back
+    void SetCacheSize(int size);	// Let each CPU keep up to "size"
+					// of the frames it frees (-FC)
+
+    int NumFree() { return numFree; }
+    int NumAllocated() { return numFrames - numFree; }
+
+  private:
+    int numFrames;			// How many there are in all
+    int numFree;			// How many of them are free
+    BitMap *inUse;			// Which of them are allocated
+    int *freeStack;			// The free frames that no CPU keeps
+    int top;				// How many there are
+    int cacheSize;			// Most frames a CPU keeps; 0 for none
+    int *cache[MAX_CPU_COUNT];		// The frames each CPU keeps
+    int cached[MAX_CPU_COUNT];		// How many each of them has
+};
+
+#endif // FRAMEALLOCATOR_H
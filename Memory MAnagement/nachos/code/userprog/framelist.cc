@@ -0,0 +1,120 @@
+// framelist.cc
+//	Routines to keep lists of physical frames, for the FIFO and LRU
+//	page replacement policies.  See framelist.h for the overall
+//	design.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "framelist.h"
+
+//----------------------------------------------------------------------
+// FrameList::FrameList
+// 	Initialize an empty list of frames.  The links live in arrays
+//	indexed by frame number, so a frame is found, moved or taken off
+//	without searching.
+//----------------------------------------------------------------------
+
+FrameList::FrameList(int numFrames)
+{
+    prev = new int[numFrames];
+    next = new int[numFrames];
+    onList = new bool[numFrames];
+    for (int i = 0; i < numFrames; i++) {
+	prev[i] = next[i] = -1;
+	onList[i] = FALSE;
+    }
+    head = tail = -1;
+    length = 0;
+}
+
+FrameList::~FrameList()
+{
+    delete [] prev;
+    delete [] next;
+    delete [] onList;
+}
+
+//----------------------------------------------------------------------
+// FrameList::Append
+// 	Make "frame" the newest frame on the list.
+//----------------------------------------------------------------------
+
+void
+FrameList::Append(int frame)
+{
+    if (onList[frame]) {
+	if (frame != tail)
+	    MoveToTail(frame);
+	return;
+    }
+    prev[frame] = tail;
+    next[frame] = -1;
+    if (tail == -1)
+	head = frame;
+    else
+	next[tail] = frame;
+    tail = frame;
+    onList[frame] = TRUE;
+    length++;
+}
+
+//----------------------------------------------------------------------
+// FrameList::Remove
+// 	Take "frame" off the list, because it was freed or is no longer
+//	a candidate for replacement.  Does nothing if it is not on it.
+//----------------------------------------------------------------------
+
+void
+FrameList::Remove(int frame)
+{
+    if (!onList[frame])
+	return;
+    if (prev[frame] == -1)
+	head = next[frame];
+    else
+	next[prev[frame]] = next[frame];
+    if (next[frame] == -1)
+	tail = prev[frame];
+    else
+	prev[next[frame]] = prev[frame];
+    onList[frame] = FALSE;
+    length--;
+}
+
+//----------------------------------------------------------------------
+// FrameList::MoveToTail
+// 	Move "frame", which is on the list but not at its tail, to the 
+//	tail.  Called on every memory reference that changes frame, so
+//	it is kept short.
+//----------------------------------------------------------------------
+
+void
+FrameList::MoveToTail(int frame)
+{
+    if (prev[frame] == -1)
+	head = next[frame];
+    else
+	next[prev[frame]] = next[frame];
+    prev[next[frame]] = prev[frame];
+    prev[frame] = tail;
+    next[frame] = -1;
+    next[tail] = frame;
+    tail = frame;
+}
+
+//----------------------------------------------------------------------
+// FrameList::First
+// 	Return the oldest frame on the list, other than "skip" (a frame
+//	the caller is still using), or -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+FrameList::First(int skip)
+{
+    if ((head == -1) || (head != skip))
+	return head;
+    return next[head];
+}
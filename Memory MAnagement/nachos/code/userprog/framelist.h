@@ -0,0 +1,51 @@
+// framelist.h
+//	Data structures to keep physical frames in the order the page
+//	replacement policies take them: the order they were loaded in
+//	(FIFO), or the order they were last used in (LRU).
+//
+//	The links live in arrays indexed by frame number, so a frame is
+//	found, moved or taken off without searching, and the oldest frame
+//	is always at the head.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMELIST_H
+#define FRAMELIST_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The following class defines a list of frames, oldest first.
+
+class FrameList {
+  public:
+    FrameList(int numFrames);		// An empty list of frames 0 to
+					// numFrames-1
+    ~FrameList();
+
+    void Append(int frame);		// Put frame at the tail, moving it
+					// if it is on the list
+    void Remove(int frame);		// Take frame off the list, if it is
+					// on it
+    int First(int skip);		// Oldest frame other than skip, -1
+					// if none
+    int Next(int frame) { return next[frame]; }	// The frame after it,
+					// -1 at the tail
+    bool Contains(int frame) { return onList[frame]; }
+    int Length() { return length; }
+    void Touch(int frame)		// Frame used: make it the newest
+	{ if ((frame != tail) && onList[frame]) MoveToTail(frame); }
+
+  private:
+    void MoveToTail(int frame);
+
+    int *prev;
+    int *next;
+    bool *onList;
+    int head, tail;			// -1 when empty
+    int length;				// Number of frames on the list
+};
+
+#endif // FRAMELIST_H
@@ -0,0 +1,167 @@
+// noffimage.cc
+//	Routines to keep track of the executables user programs are
+//	running, and to read their pages in on demand.  See noffimage.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "noffimage.h"
+
+static NoffImage *images = NULL;	// Executables being run
+
+//----------------------------------------------------------------------
+// SwapHeader
+// 	Do little endian to big endian conversion on the bytes in the
+//	object file header, in case the file was generated on a little
+//	endian machine, and we're now running on a big endian machine.
+//----------------------------------------------------------------------
+
+static void
+SwapHeader (NoffHeader *noffH)
+{
+	noffH->noffMagic = WordToHost(noffH->noffMagic);
+	noffH->code.size = WordToHost(noffH->code.size);
+	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
+	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
+	noffH->initData.size = WordToHost(noffH->initData.size);
+	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
+	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
+	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
+	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
+	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+}
+
+//----------------------------------------------------------------------
+// NoffImage::Open
+// 	Return the image of executable "name", with a new reference to
+//	it.  "executable" is the file, just opened; it is kept if this
+//	is the first process to run "name", and closed otherwise.
+//----------------------------------------------------------------------
+
+NoffImage *
+NoffImage::Open(OpenFile *executable, char *name)
+{
+    NoffImage *image;
+
+    for (image = images; image != NULL; image = image->next)
+	if (!strcmp(image->name, name)) {
+	    delete executable;
+	    image->Retain();
+	    return image;
+	}
+    image = new NoffImage(executable, name);
+    image->next = images;
+    images = image;
+    return image;
+}
+
+//----------------------------------------------------------------------
+// NoffImage::NoffImage
+// 	Read the header of "executable", once for all the processes
+//	that will run it, and check that it is a NOFF file.
+//----------------------------------------------------------------------
+
+NoffImage::NoffImage(OpenFile *executable, char *fileName)
+{
+    file = executable;
+    name = new char[strlen(fileName) + 1];
+    strcpy(name, fileName);
+    refCount = 1;
+    next = NULL;
+
+    file->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if ((noffH.noffMagic != NOFFMAGIC) &&
+		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    	SwapHeader(&noffH);
+    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    DEBUG('a', "Opened %s: code %d, data %d, bss %d bytes\n", name,
+		noffH.code.size, noffH.initData.size, noffH.uninitData.size);
+}
+
+NoffImage::~NoffImage()
+{
+    delete file;
+    delete [] name;
+}
+
+//----------------------------------------------------------------------
+// NoffImage::Release
+// 	Drop a reference to the image.  When the last process running
+//	the executable is done with it, close the file.
+//----------------------------------------------------------------------
+
+void
+NoffImage::Release()
+{
+    NoffImage **link;
+
+    ASSERT(refCount > 0);
+    if (--refCount > 0)
+	return;
+    for (link = &images; *link != this; link = &(*link)->next)
+	;
+    *link = next;
+    delete this;
+}
+
+//----------------------------------------------------------------------
+// NoffImage::Overlaps
+// 	Return TRUE if segment "seg" covers part of virtual page "vpn",
+//	and put the first and last-plus-one offsets within the page that
+//	it covers in "from" and "to".
+//----------------------------------------------------------------------
+
+bool
+NoffImage::Overlaps(Segment *seg, int vpn, int *from, int *to)
+{
+    int start = vpn * PageSize, end = start + PageSize;
+
+    if ((seg->size <= 0) || (seg->virtualAddr >= end)
+			|| (seg->virtualAddr + seg->size <= start))
+	return FALSE;
+    *from = max(seg->virtualAddr, start) - start;
+    *to = min(seg->virtualAddr + seg->size, end) - start;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// NoffImage::PageKind
+// 	Classify virtual page "vpn": code, initialized data, or a page
+//	that starts out as all zero (uninitialized data, or the stack).
+//----------------------------------------------------------------------
+
+NoffPageKind
+NoffImage::PageKind(int vpn)
+{
+    int from, to;
+
+    if (Overlaps(&noffH.code, vpn, &from, &to))
+	return CodePage;
+    if (Overlaps(&noffH.initData, vpn, &from, &to))
+	return DataPage;
+    return ZeroPage;
+}
+
+//----------------------------------------------------------------------
+// NoffImage::ReadPage
+// 	Fill "into" with the initial contents of virtual page "vpn":
+//	the parts of it that are code or initialized data are read from
+//	where those segments are in the file, and the rest is zeroed.
+//----------------------------------------------------------------------
+
+void
+NoffImage::ReadPage(int vpn, char *into)
+{
+    int from, to;
+
+    bzero(into, PageSize);
+    if (Overlaps(&noffH.code, vpn, &from, &to))
+	file->ReadAt(into + from, to - from, noffH.code.inFileAddr
+			+ vpn * PageSize + from - noffH.code.virtualAddr);
+    if (Overlaps(&noffH.initData, vpn, &from, &to))
+	file->ReadAt(into + from, to - from, noffH.initData.inFileAddr
+			+ vpn * PageSize + from - noffH.initData.virtualAddr);
+}
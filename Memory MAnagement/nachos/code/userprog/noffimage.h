@@ -0,0 +1,63 @@
+// noffimage.h
+//	Data structures describing an executable that user programs are
+//	running: its open file, and its NOFF header, read once.
+//
+//	All the processes running the same executable (by name), and the
+//	children they fork, share one image, which is reference counted;
+//	the file is closed when the last of them lets go of it.
+//
+//	The header tells which part of a page comes from the code, which
+//	from the initialized data, and which must be zero (uninitialized
+//	data and the stack), so a page fault reads exactly the bytes the
+//	page needs from the file, and nothing for a page that is all zero.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef NOFFIMAGE_H
+#define NOFFIMAGE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "openfile.h"
+#include "noff.h"
+
+// What a virtual page holds, in the file.  A page that straddles
+// segments is a code page if any of it is code.
+
+enum NoffPageKind { CodePage, DataPage, ZeroPage };
+
+// The following class defines an executable being run.
+
+class NoffImage {
+  public:
+    static NoffImage *Open(OpenFile *executable, char *name);	// The image
+					// of "name", which is open as
+					// "executable"; the image takes over
+					// the file, and closes it if it
+					// already has one
+    void Retain() { refCount++; }	// Add a reference
+    void Release();			// Drop a reference; the image goes
+					// away once there are none left
+
+    NoffHeader *Header() { return &noffH; }
+    NoffPageKind PageKind(int vpn);	// What page "vpn" holds
+    void ReadPage(int vpn, char *into);	// Put the initial contents of
+					// page "vpn" in "into"
+
+  private:
+    NoffImage(OpenFile *executable, char *name);
+    ~NoffImage();
+    bool Overlaps(Segment *seg, int vpn, int *from, int *to);	// Does
+					// "seg" cover part of page "vpn"?
+					// Which bytes of the page?
+
+    char *name;				// As the executable was opened
+    OpenFile *file;
+    NoffHeader noffH;			// In host byte order
+    int refCount;
+    NoffImage *next;			// Next image being run
+};
+
+#endif // NOFFIMAGE_H
@@ -0,0 +1,938 @@
+// pagepolicy.cc
+//	Routines for the adaptive page replacement policies.  See
+//	pagepolicy.h for the overall design.
+//
+//	The size of the cache, "c" in the papers, is "numFrames": the
+//	kernel uses NumPhysPages, and the trace replay (pagetrace.cc) tries
+//	other sizes.  Each ghost list remembers at most that many pages.
+//
+//	All of these are called with interrupts off, from the page fault
+//	handler, the address translation code, or thread exit.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "pagepolicy.h"
+
+//----------------------------------------------------------------------
+// PageHistory::PageHistory
+// 	Initialize an empty history.  Entries are kept in arrays, linked
+//	into the list and into hash chains by index, so that adding and
+//	removing pages never calls the allocator.
+//
+//	"size" -- the most pages the history holds
+//----------------------------------------------------------------------
+
+PageHistory::PageHistory(int historySize)
+{
+    int i;
+
+    size = historySize;
+    length = 0;
+    pageId = new int[size];
+    pageVpn = new int[size];
+    pageFrame = new int[size];
+    prev = new int[size];
+    next = new int[size];
+    chain = new int[size];
+    numBuckets = size;
+    bucket = new int[numBuckets];
+    for (i = 0; i < numBuckets; i++)
+	bucket[i] = -1;
+    for (i = 0; i < size; i++)
+	chain[i] = i + 1;
+    chain[size - 1] = -1;
+    freeList = 0;
+    head = tail = -1;
+}
+
+PageHistory::~PageHistory()
+{
+    delete [] pageId;
+    delete [] pageVpn;
+    delete [] pageFrame;
+    delete [] prev;
+    delete [] next;
+    delete [] chain;
+    delete [] bucket;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::Find
+// 	Return the entry holding page "vpn" of process "pid", or -1 if
+//	the page is not on the list.
+//----------------------------------------------------------------------
+
+int
+PageHistory::Find(int pid, int vpn)
+{
+    int entry;
+
+    for (entry = bucket[Bucket(pid, vpn)]; entry != -1; entry = chain[entry])
+	if ((pageId[entry] == pid) && (pageVpn[entry] == vpn))
+	    return entry;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::Append
+// 	Add a page to the list, as the newest.  The page must not be on
+//	the list already, and the list must not be full.
+//----------------------------------------------------------------------
+
+void
+PageHistory::Append(int pid, int vpn, int frame)
+{
+    int entry = freeList;
+    int b = Bucket(pid, vpn);
+
+    ASSERT(entry != -1);
+    ASSERT(Find(pid, vpn) == -1);
+    freeList = chain[entry];
+
+    pageId[entry] = pid;
+    pageVpn[entry] = vpn;
+    pageFrame[entry] = frame;
+    chain[entry] = bucket[b];
+    bucket[b] = entry;
+
+    prev[entry] = tail;
+    next[entry] = -1;
+    if (tail == -1) head = entry;
+    else next[tail] = entry;
+    tail = entry;
+    length++;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::Unlink
+// 	Take "entry" off the list and out of its hash chain, and put it
+//	back on the free list.
+//----------------------------------------------------------------------
+
+void
+PageHistory::Unlink(int entry)
+{
+    int *link = &bucket[Bucket(pageId[entry], pageVpn[entry])];
+
+    while (*link != entry)
+	link = &chain[*link];
+    *link = chain[entry];
+
+    if (prev[entry] == -1) head = next[entry];
+    else next[prev[entry]] = next[entry];
+    if (next[entry] == -1) tail = prev[entry];
+    else prev[next[entry]] = prev[entry];
+
+    chain[entry] = freeList;
+    freeList = entry;
+    length--;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::Remove
+// 	Take page "vpn" of process "pid" off the list.  Returns FALSE if
+//	it was not on it.
+//----------------------------------------------------------------------
+
+bool
+PageHistory::Remove(int pid, int vpn)
+{
+    int entry = Find(pid, vpn);
+
+    if (entry == -1)
+	return FALSE;
+    Unlink(entry);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::First
+// 	Return the oldest page on the list through "pid", "vpn" and
+//	"frame", without removing it.  Returns FALSE if the list is empty.
+//----------------------------------------------------------------------
+
+bool
+PageHistory::First(int *pid, int *vpn, int *frame)
+{
+    if (head == -1)
+	return FALSE;
+    *pid = pageId[head];
+    *vpn = pageVpn[head];
+    *frame = pageFrame[head];
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::GetFrame/SetFrame
+// 	Read or change the frame noted for a page on the list.
+//----------------------------------------------------------------------
+
+int
+PageHistory::GetFrame(int pid, int vpn)
+{
+    int entry = Find(pid, vpn);
+
+    ASSERT(entry != -1);
+    return pageFrame[entry];
+}
+
+void
+PageHistory::SetFrame(int pid, int vpn, int frame)
+{
+    int entry = Find(pid, vpn);
+
+    ASSERT(entry != -1);
+    pageFrame[entry] = frame;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::Rename
+// 	Page "vpn" of process "pid" now belongs to process "newPid".
+//	Move it to its new hash chain; its place on the list is kept.
+//----------------------------------------------------------------------
+
+void
+PageHistory::Rename(int pid, int vpn, int newPid)
+{
+    int entry = Find(pid, vpn);
+    int *link;
+    int b;
+
+    if (entry == -1)
+	return;
+    for (link = &bucket[Bucket(pid, vpn)]; *link != entry; link = &chain[*link])
+	;
+    *link = chain[entry];
+
+    ASSERT(Find(newPid, vpn) == -1);
+    pageId[entry] = newPid;
+    b = Bucket(newPid, vpn);
+    chain[entry] = bucket[b];
+    bucket[b] = entry;
+}
+
+//----------------------------------------------------------------------
+// PageHistory::Forget
+// 	Remove every page of process "pid" from the list, and from the
+//	list "also" as well, unless it is NULL.
+//----------------------------------------------------------------------
+
+void
+PageHistory::Forget(int pid, PageHistory *also)
+{
+    int entry = head;
+    int following;
+
+    while (entry != -1) {
+	following = next[entry];
+	if (pageId[entry] == pid) {
+	    if (also != NULL)
+		also->Remove(pid, pageVpn[entry]);
+	    Unlink(entry);
+	}
+	entry = following;
+    }
+}
+
+//----------------------------------------------------------------------
+// PagePolicy::PagePolicy
+// 	No frame has been given to the policy yet.
+//
+//	"frames" -- the number of frames of memory
+//----------------------------------------------------------------------
+
+PagePolicy::PagePolicy(int frames)
+{
+    numFrames = frames;
+    managed = new bool[numFrames];
+    framePid = new int[numFrames];
+    frameVpn = new int[numFrames];
+    used = new bool[numFrames];
+    fresh = new bool[numFrames];
+    for (int i = 0; i < numFrames; i++) {
+	managed[i] = used[i] = fresh[i] = FALSE;
+	framePid[i] = frameVpn[i] = -1;
+    }
+}
+
+PagePolicy::~PagePolicy()
+{
+    delete [] managed;
+    delete [] framePid;
+    delete [] frameVpn;
+    delete [] used;
+    delete [] fresh;
+}
+
+//----------------------------------------------------------------------
+// PagePolicy::Harvest
+// 	Called at each fault, and before each choice of a victim: tell
+//	the policy which of its pages have been used since the last
+//	call, and clear their use bits.  The first time a page is seen
+//	used after it was loaded, that is the instruction that faulted
+//	it in, run again, and not a second use.
+//----------------------------------------------------------------------
+
+void
+PagePolicy::Harvest()
+{
+    for (int i = 0; i < numFrames; i++) {
+	if (!managed[i] || !used[i])
+	    continue;
+	if (fresh[i])
+	    fresh[i] = FALSE;
+	else
+	    Referenced(i);
+	used[i] = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// PagePolicy::Load
+// 	Page "vpn" of process "pid" has just been brought into "frame";
+//	the policy decides where it goes, from what it remembers of the
+//	page.  Loading a page also counts as its first reference, and
+//	uses of it before the next fault are that same reference.
+//----------------------------------------------------------------------
+
+void
+PagePolicy::Load(int frame, int pid, int vpn)
+{
+    ASSERT(!managed[frame]);
+    Harvest();				// before the new page counts
+    managed[frame] = TRUE;
+    framePid[frame] = pid;
+    frameVpn[frame] = vpn;
+    used[frame] = FALSE;		// a bit the last page left
+    fresh[frame] = TRUE;
+    Loaded(frame);
+}
+
+//----------------------------------------------------------------------
+// PagePolicy::Evict
+// 	The page in "frame", chosen by Victim, is being replaced.  The
+//	policy may keep it as a ghost.
+//----------------------------------------------------------------------
+
+void
+PagePolicy::Evict(int frame)
+{
+    ASSERT(managed[frame]);
+    Evicted(frame);
+    managed[frame] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// PagePolicy::Free
+// 	"frame" has been freed by a process that is exiting.  Its page
+//	will never be used again, so no ghost is kept.
+//----------------------------------------------------------------------
+
+void
+PagePolicy::Free(int frame)
+{
+    if (!managed[frame])
+	return;
+    Freed(frame);
+    managed[frame] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// PagePolicy::Rename
+// 	The page in "frame", which several processes map, has passed
+//	to process "pid", so that it keeps a name no other resident
+//	page has.
+//----------------------------------------------------------------------
+
+void
+PagePolicy::Rename(int frame, int pid)
+{
+    int oldPid = framePid[frame];
+
+    if (!managed[frame] || (oldPid == pid))
+	return;
+    framePid[frame] = pid;
+    Renamed(frame, oldPid);
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::ARCPolicy
+// 	Start with every list empty, and no preference between T1 and T2.
+//----------------------------------------------------------------------
+
+ARCPolicy::ARCPolicy(int frames) : PagePolicy(frames)
+{
+    t1 = new FrameList(numFrames);
+    t2 = new FrameList(numFrames);
+    b1 = new PageHistory(numFrames);
+    b2 = new PageHistory(numFrames);
+    target = 0;
+}
+
+ARCPolicy::~ARCPolicy()
+{
+    delete t1;
+    delete t2;
+    delete b1;
+    delete b2;
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::Choose
+// 	Replace the oldest page of T1 if T1 is over its target size,
+//	otherwise the least recently used page of T2.
+//----------------------------------------------------------------------
+
+int
+ARCPolicy::Choose(int skip)
+{
+    FrameList *from = t2, *other = t1;
+    int x;
+
+    if ((t1->Length() > 0) && ((t1->Length() > target) || (t2->Length() == 0))) {
+	from = t1;
+	other = t2;
+    }
+    x = from->First(skip);
+    if (x == -1)
+	x = other->First(skip);
+    return x;
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::Referenced
+// 	A second use moves a page from T1 to T2; later uses make it the
+//	most recently used page of T2.
+//----------------------------------------------------------------------
+
+void
+ARCPolicy::Referenced(int frame)
+{
+    if (t1->Contains(frame)) {
+	t1->Remove(frame);
+	t2->Append(frame);
+    } else
+	t2->Touch(frame);
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::Loaded
+// 	A fault on a ghost in B1 means T1 was too small, so its target
+//	grows; a fault on a ghost in B2 means T2 was.  Either way the
+//	page has now been used twice and goes into T2.  Any other page
+//	goes into T1, after making room for its ghost to come.
+//----------------------------------------------------------------------
+
+void
+ARCPolicy::Loaded(int frame)
+{
+    int pid = framePid[frame], vpn = frameVpn[frame];
+    int p, v, f;
+
+    if (b1->Contains(pid, vpn)) {
+	target = min(numFrames,
+		     target + max(b2->Length() / b1->Length(), 1));
+	b1->Remove(pid, vpn);
+	t2->Append(frame);
+	DEBUG('a', "ARC: ghost hit in B1, target now %d\n", target);
+    } else if (b2->Contains(pid, vpn)) {
+	target = max(0, target - max(b1->Length() / b2->Length(), 1));
+	b2->Remove(pid, vpn);
+	t2->Append(frame);
+	DEBUG('a', "ARC: ghost hit in B2, target now %d\n", target);
+    } else {
+	if (t1->Length() + b1->Length() >= numFrames) {
+	    if (b1->First(&p, &v, &f))
+		b1->Remove(p, v);
+	} else if (t1->Length() + t2->Length() + b1->Length() + b2->Length()
+						>= 2 * numFrames) {
+	    if (b2->First(&p, &v, &f))
+		b2->Remove(p, v);
+	}
+	t1->Append(frame);
+    }
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::Evicted
+// 	Remember the page in the ghost list of the list it leaves.
+//----------------------------------------------------------------------
+
+void
+ARCPolicy::Evicted(int frame)
+{
+    PageHistory *ghosts = t1->Contains(frame) ? b1 : b2;
+    int p, v, f;
+
+    t1->Remove(frame);
+    t2->Remove(frame);
+    if (ghosts->IsFull() && ghosts->First(&p, &v, &f))
+	ghosts->Remove(p, v);
+    ghosts->Append(framePid[frame], frameVpn[frame], -1);
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::Freed/Forget
+// 	Drop a freed frame, and the ghosts of a process that has exited.
+//----------------------------------------------------------------------
+
+void
+ARCPolicy::Freed(int frame)
+{
+    t1->Remove(frame);
+    t2->Remove(frame);
+}
+
+void
+ARCPolicy::Forget(int pid)
+{
+    b1->Forget(pid, NULL);
+    b2->Forget(pid, NULL);
+}
+
+//----------------------------------------------------------------------
+// ARCPolicy::Renamed
+// 	The page in "frame" has passed to the process now in framePid,
+//	which may have a ghost of it, left when the page was replaced
+//	while that process owned it.  The ghost is out of date now.
+//----------------------------------------------------------------------
+
+void
+ARCPolicy::Renamed(int frame, int oldPid)
+{
+    b1->Remove(framePid[frame], frameVpn[frame]);
+    b2->Remove(framePid[frame], frameVpn[frame]);
+}
+
+//----------------------------------------------------------------------
+// CARPolicy::CARPolicy
+// 	Every reference bit starts out clear.
+//----------------------------------------------------------------------
+
+CARPolicy::CARPolicy(int frames) : ARCPolicy(frames)
+{
+    referenced = new bool[numFrames];
+    for (int i = 0; i < numFrames; i++)
+	referenced[i] = FALSE;
+}
+
+CARPolicy::~CARPolicy()
+{
+    delete [] referenced;
+}
+
+//----------------------------------------------------------------------
+// CARPolicy::Choose
+// 	Sweep the clock of T1 if it is at or over its target, and the
+//	clock of T2 otherwise.  A page with its reference bit set gets
+//	a second chance: in T1 it moves to T2, in T2 it goes round again.
+//	Both clocks are kept as lists, oldest first, so the hand is
+//	always at the head.
+//
+//	The sweep stops after every page has had its second chance; only
+//	"skip" could be left, and then ARC's choice is used instead.
+//----------------------------------------------------------------------
+
+int
+CARPolicy::Choose(int skip)
+{
+    int steps = 2 * (t1->Length() + t2->Length()) + 2;
+    FrameList *clock;
+    int x;
+
+    while (steps-- > 0) {
+	if ((t1->Length() >= max(1, target)) || (t2->Length() == 0))
+	    clock = t1;
+	else
+	    clock = t2;
+	x = clock->First(-1);
+	if (x == -1)
+	    break;
+	if (x == skip) {
+	    clock->Append(x);		// step the hand past it
+	    continue;
+	}
+	if (!referenced[x])
+	    return x;
+	referenced[x] = FALSE;
+	if (clock == t1)
+	    t1->Remove(x);
+	t2->Append(x);
+    }
+    return ARCPolicy::Choose(skip);
+}
+
+//----------------------------------------------------------------------
+// CARPolicy::Loaded
+// 	As in ARC, with the reference bit of the new page clear.
+//----------------------------------------------------------------------
+
+void
+CARPolicy::Loaded(int frame)
+{
+    referenced[frame] = FALSE;
+    ARCPolicy::Loaded(frame);
+}
+
+//----------------------------------------------------------------------
+// TwoQPolicy::TwoQPolicy
+// 	A1out remembers half as many pages as there are frames, the
+//	setting recommended in the paper.
+//----------------------------------------------------------------------
+
+TwoQPolicy::TwoQPolicy(int frames) : PagePolicy(frames)
+{
+    a1in = new FrameList(numFrames);
+    am = new FrameList(numFrames);
+    a1out = new PageHistory(max(1, numFrames / 2));
+}
+
+TwoQPolicy::~TwoQPolicy()
+{
+    delete a1in;
+    delete am;
+    delete a1out;
+}
+
+//----------------------------------------------------------------------
+// TwoQPolicy::Choose
+// 	Take the oldest page of A1in while it holds more than a quarter
+//	of the frames, and the least recently used page of Am otherwise.
+//----------------------------------------------------------------------
+
+int
+TwoQPolicy::Choose(int skip)
+{
+    FrameList *from = am, *other = a1in;
+    int x;
+
+    if ((a1in->Length() > numFrames / 4) || (am->Length() == 0)) {
+	from = a1in;
+	other = am;
+    }
+    x = from->First(skip);
+    if (x == -1)
+	x = other->First(skip);
+    return x;
+}
+
+//----------------------------------------------------------------------
+// TwoQPolicy::Loaded
+// 	A page remembered in A1out has been used again after leaving
+//	A1in, so it goes into Am; any other page starts in A1in.
+//----------------------------------------------------------------------
+
+void
+TwoQPolicy::Loaded(int frame)
+{
+    if (a1out->Remove(framePid[frame], frameVpn[frame]))
+	am->Append(frame);
+    else
+	a1in->Append(frame);
+}
+
+//----------------------------------------------------------------------
+// TwoQPolicy::Evicted
+// 	A page leaving A1in is remembered in A1out, forgetting the oldest
+//	one there if it is full.  A page leaving Am is simply dropped.
+//----------------------------------------------------------------------
+
+void
+TwoQPolicy::Evicted(int frame)
+{
+    int p, v, f;
+
+    if (a1in->Contains(frame)) {
+	a1in->Remove(frame);
+	if (a1out->IsFull() && a1out->First(&p, &v, &f))
+	    a1out->Remove(p, v);
+	a1out->Append(framePid[frame], frameVpn[frame], -1);
+    } else
+	am->Remove(frame);
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::LIRSPolicy
+// 	One percent of the frames, and at least one, hold HIR pages, as
+//	suggested in the paper.  The stack can hold every resident page
+//	and as many ghosts again.
+//----------------------------------------------------------------------
+
+LIRSPolicy::LIRSPolicy(int frames) : PagePolicy(frames)
+{
+    recency = new PageHistory(2 * numFrames);
+    ghosts = new PageHistory(numFrames);
+    hirs = new FrameList(numFrames);
+    isLIR = new bool[numFrames];
+    for (int i = 0; i < numFrames; i++)
+	isLIR[i] = FALSE;
+    numLIR = 0;
+    maxLIR = numFrames - max(1, numFrames / 100);
+}
+
+LIRSPolicy::~LIRSPolicy()
+{
+    delete recency;
+    delete ghosts;
+    delete hirs;
+    delete [] isLIR;
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Push
+// 	Put a page on top of the stack, taking it out of the middle if it
+//	is already there.  If the stack is full, the oldest ghost on it is
+//	forgotten to make room.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Push(int pid, int vpn, int frame)
+{
+    int p, v, f;
+
+    if (!recency->Remove(pid, vpn) && recency->IsFull()
+					&& ghosts->First(&p, &v, &f)) {
+	ghosts->Remove(p, v);
+	recency->Remove(p, v);
+    }
+    recency->Append(pid, vpn, frame);
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Prune
+// 	Pop HIR pages, resident or not, off the bottom of the stack, so
+//	that the bottom page is LIR.  A ghost popped off is forgotten.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Prune()
+{
+    int p, v, f;
+
+    while (recency->First(&p, &v, &f) && ((f == -1) || !isLIR[f])) {
+	recency->Remove(p, v);
+	if (f == -1)
+	    ghosts->Remove(p, v);
+    }
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::DemoteBottom
+// 	There are too many LIR pages: the one at the bottom of the stack,
+//	used least recently, becomes a resident HIR page.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::DemoteBottom()
+{
+    int p, v, f;
+
+    if (!recency->First(&p, &v, &f))
+	return;
+    ASSERT((f != -1) && isLIR[f]);
+    recency->Remove(p, v);
+    isLIR[f] = FALSE;
+    numLIR--;
+    hirs->Append(f);
+    Prune();
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::MakeLIR
+// 	Make the page in "frame" LIR and put it on top of the stack,
+//	demoting the bottom LIR page if that makes too many.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::MakeLIR(int frame)
+{
+    int pid = framePid[frame], vpn = frameVpn[frame];
+
+    hirs->Remove(frame);
+    Push(pid, vpn, frame);
+    isLIR[frame] = TRUE;
+    numLIR++;
+    if (numLIR > maxLIR)
+	DemoteBottom();
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Choose
+// 	Replace the oldest resident HIR page.  There is none only while
+//	the LIR pages are filling memory, or when the one there is
+//	"skip"; then the least recently used LIR page goes instead.
+//----------------------------------------------------------------------
+
+int
+LIRSPolicy::Choose(int skip)
+{
+    int x = hirs->First(skip);
+    int p, v, f;
+
+    if (x == -1) {
+	if (!recency->First(&p, &v, &f) || (f == skip))
+	    return -1;
+	x = f;
+    }
+    return x;
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Referenced
+// 	A LIR page moves to the top of the stack.  A resident HIR page
+//	still on the stack has been used again sooner than the oldest LIR
+//	page, so it becomes LIR; one that is not goes back on the stack
+//	and to the end of the HIR queue.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Referenced(int frame)
+{
+    int pid = framePid[frame], vpn = frameVpn[frame];
+    int p, v, f;
+    bool wasBottom;
+
+    if (isLIR[frame]) {
+	wasBottom = recency->First(&p, &v, &f) && (f == frame);
+	Push(pid, vpn, frame);
+	if (wasBottom)
+	    Prune();
+    } else if (recency->Contains(pid, vpn))
+	MakeLIR(frame);
+    else {
+	Push(pid, vpn, frame);
+	hirs->Append(frame);
+    }
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Loaded
+// 	Until the LIR frames are filled, every new page is LIR.  After
+//	that, a page whose ghost is still on the stack becomes LIR, and
+//	any other page starts out as a resident HIR page.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Loaded(int frame)
+{
+    int pid = framePid[frame], vpn = frameVpn[frame];
+    bool wasGhost = ghosts->Remove(pid, vpn);
+
+    isLIR[frame] = FALSE;
+    if (numLIR < maxLIR) {
+	Push(pid, vpn, frame);
+	isLIR[frame] = TRUE;
+	numLIR++;
+    } else if (wasGhost) {
+	DEBUG('a', "LIRS: ghost hit for page %d of %d\n", vpn, pid);
+	MakeLIR(frame);
+    } else {
+	Push(pid, vpn, frame);
+	hirs->Append(frame);
+    }
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Evicted
+// 	A resident HIR page still on the stack stays there as a ghost.
+//	A LIR page is only replaced when there was no HIR page to take,
+//	and leaves the stack.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Evicted(int frame)
+{
+    int pid = framePid[frame], vpn = frameVpn[frame];
+    int p, v, f;
+
+    if (isLIR[frame]) {
+	recency->Remove(pid, vpn);
+	isLIR[frame] = FALSE;
+	numLIR--;
+	Prune();
+    } else {
+	hirs->Remove(frame);
+	if (recency->Contains(pid, vpn)) {
+	    if (ghosts->IsFull() && ghosts->First(&p, &v, &f)) {
+		ghosts->Remove(p, v);
+		recency->Remove(p, v);
+	    }
+	    recency->SetFrame(pid, vpn, -1);
+	    ghosts->Append(pid, vpn, -1);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Freed
+// 	Take a freed frame off the stack and the HIR queue.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Freed(int frame)
+{
+    recency->Remove(framePid[frame], frameVpn[frame]);
+    hirs->Remove(frame);
+    if (isLIR[frame]) {
+	isLIR[frame] = FALSE;
+	numLIR--;
+    }
+    Prune();
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Renamed
+// 	The page in "frame" has passed from process "oldPid" to the
+//	process now in framePid; its place on the stack is kept.
+//
+//	The new owner may have a ghost of the page, left when its own
+//	copy was replaced, before it mapped the shared one; it is out of
+//	date now.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Renamed(int frame, int oldPid)
+{
+    if (ghosts->Remove(framePid[frame], frameVpn[frame]))
+	recency->Remove(framePid[frame], frameVpn[frame]);
+    recency->Rename(oldPid, frameVpn[frame], framePid[frame]);
+}
+
+//----------------------------------------------------------------------
+// LIRSPolicy::Forget
+// 	Drop the ghosts of a process that has exited, from the stack too.
+//----------------------------------------------------------------------
+
+void
+LIRSPolicy::Forget(int pid)
+{
+    ghosts->Forget(pid, recency);
+    Prune();
+}
+
+//----------------------------------------------------------------------
+// NewPagePolicy
+// 	Return the policy for replacement algorithm "algo" (-R) over
+//	"numFrames" frames, or NULL for the ones PageReplace implements
+//	itself.
+//----------------------------------------------------------------------
+
+PagePolicy *
+NewPagePolicy(int algo, int numFrames)
+{
+    switch (algo) {
+      case REPLACE_ARC:
+	return new ARCPolicy(numFrames);
+      case REPLACE_CAR:
+	return new CARPolicy(numFrames);
+      case REPLACE_2Q:
+	return new TwoQPolicy(numFrames);
+      case REPLACE_LIRS:
+	return new LIRSPolicy(numFrames);
+      default:
+	return NULL;
+    }
+}
@@ -0,0 +1,227 @@
+// pagepolicy.h
+//	Data structures for the adaptive page replacement policies:
+//	ARC, CAR, 2Q and LIRS.
+//
+//	Unlike random, FIFO, LRU and clock, which PageReplace implements
+//	directly, these policies remember pages that were recently
+//	evicted ("ghosts"), and use a fault on a ghost as a sign that
+//	the page should have been kept.  That way a sweep over more
+//	memory than there is cannot push out the pages that are used
+//	over and over.
+//
+//	A page is named by the pid of its process and its virtual page
+//	number while it is a ghost, and by its frame while it is resident.
+//
+//	A use of a page only sets the use bit of its frame.  The policy
+//	hears of the pages used since the last fault at the next one
+//	(Harvest), so a page is re-used at most once per fault, and the
+//	use that faulted it in, with the retried instruction, is not a
+//	re-use at all.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PAGEPOLICY_H
+#define PAGEPOLICY_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "system.h"
+
+// Values of rep_algo (-R) beyond the four built into PageReplace
+
+#define REPLACE_ARC	5
+#define REPLACE_CAR	6
+#define REPLACE_2Q	7
+#define REPLACE_LIRS	8
+
+// A list of pages, oldest first, that can also be searched by name.
+// Each entry may note the frame of the page, -1 if it is a ghost.
+
+class PageHistory {
+  public:
+    PageHistory(int size);		// Initialize an empty history of at
+    ~PageHistory();			// most "size" pages
+
+    void Append(int pid, int vpn, int frame);	// Add a page as the newest
+    bool Remove(int pid, int vpn);	// Take a page off; FALSE if absent
+    bool Contains(int pid, int vpn) { return (Find(pid, vpn) >= 0); }
+    bool First(int *pid, int *vpn, int *frame);	// The oldest page;
+					// FALSE if the history is empty
+    int GetFrame(int pid, int vpn);	// Frame noted for a page on the list
+    void SetFrame(int pid, int vpn, int frame);
+    void Rename(int pid, int vpn, int newPid);	// The page now belongs
+					// to process "newPid"; keep its place
+    void Forget(int pid, PageHistory *also);	// Remove every page of
+					// process "pid", here and from "also"
+    int Length() { return length; }
+    bool IsFull() { return (length == size); }
+
+  private:
+    int Find(int pid, int vpn);		// Entry holding a page, -1 if none
+    int Bucket(int pid, int vpn)
+	{ return ((unsigned) (pid * 31 + vpn)) % numBuckets; }
+    void Unlink(int entry);		// Take an entry off the list and
+					// out of its hash chain
+
+    int size, length;
+    int *pageId, *pageVpn, *pageFrame;	// Contents of each entry
+    int *prev, *next;			// The list, oldest to newest
+    int *chain;				// Next entry in the same hash bucket,
+					// or the next free entry
+    int *bucket;			// First entry in each hash bucket
+    int numBuckets;
+    int head, tail, freeList;
+};
+
+// The following class defines the interface PageReplace and the page
+// fault handler use to drive an adaptive policy.  A frame several
+// processes map is known by its owner in the reverse map (rmap.h).
+
+class PagePolicy {
+  public:
+    PagePolicy(int numFrames);
+    virtual ~PagePolicy();
+
+    void Reference(int frame)		// The running program used "frame":
+	{ used[frame] = TRUE; }		// set its use bit, for Harvest
+
+    void Load(int frame, int pid, int vpn);	// Page "vpn" of "pid" has
+					// been brought into "frame"
+    void Evict(int frame);		// The page in "frame", chosen by
+					// Victim, is being replaced
+    void Free(int frame);		// "frame" was freed by an exiting
+					// process: forget it, leaving no ghost
+    void Rename(int frame, int pid);	// Process "pid" now owns the page
+					// in "frame", shared since a fork
+    virtual void Forget(int pid) = 0;	// Process "pid" is gone: drop its ghosts
+    int Victim(int skip)		// Choose a frame to replace, other
+	{ Harvest(); return Choose(skip); }	// than "skip"
+
+  protected:
+    void Harvest();			// Pass on the use bits set since the
+					// last fault, and clear them
+    virtual int Choose(int skip) = 0;
+    virtual void Referenced(int frame) = 0;
+    virtual void Loaded(int frame) = 0;
+    virtual void Evicted(int frame) = 0;
+    virtual void Freed(int frame) = 0;
+    virtual void Renamed(int frame, int oldPid) {}
+
+    int numFrames;			// Size of memory, "c" in the papers
+    bool *managed;			// Is the frame given to the policy?
+    int *framePid;			// Page held by each such frame
+    int *frameVpn;
+    bool *used;				// Use bit of each frame
+    bool *fresh;			// Not seen used since it was loaded:
+					// its next use is the faulting one
+};
+
+// Adaptive Replacement Cache (Megiddo and Modha).  T1 holds pages used
+// once lately, T2 pages used at least twice; B1 and B2 are their
+// ghosts.  The target size "target" of T1 grows on a hit in B1 and
+// shrinks on a hit in B2.
+
+class ARCPolicy : public PagePolicy {
+  public:
+    ARCPolicy(int numFrames);
+    ~ARCPolicy();
+
+    void Forget(int pid);
+
+  protected:
+    int Choose(int skip);
+    void Referenced(int frame);
+    void Loaded(int frame);
+    void Evicted(int frame);
+    void Freed(int frame);
+    void Renamed(int frame, int oldPid);
+
+    FrameList *t1, *t2;
+    PageHistory *b1, *b2;
+    int target;
+};
+
+// Clock with Adaptive Replacement (Bansal and Modha): ARC with T1 and
+// T2 kept as clocks of reference bits, so a reference costs no list
+// operation.
+
+class CARPolicy : public ARCPolicy {
+  public:
+    CARPolicy(int numFrames);
+    ~CARPolicy();
+
+  protected:
+    int Choose(int skip);
+    void Referenced(int frame) { referenced[frame] = TRUE; }
+    void Loaded(int frame);
+
+    bool *referenced;
+};
+
+// 2Q (Johnson and Shasha).  New pages go through a FIFO, A1in; only a
+// page faulted back in while remembered in A1out, the ghosts of A1in,
+// enters the LRU list Am.
+
+class TwoQPolicy : public PagePolicy {
+  public:
+    TwoQPolicy(int numFrames);
+    ~TwoQPolicy();
+
+    void Forget(int pid) { a1out->Forget(pid, NULL); }
+
+  protected:
+    int Choose(int skip);
+    void Referenced(int frame) { am->Touch(frame); }
+    void Loaded(int frame);
+    void Evicted(int frame);
+    void Freed(int frame) { a1in->Remove(frame); am->Remove(frame); }
+    void Renamed(int frame, int oldPid)	// drop the new owner's ghost
+	{ a1out->Remove(framePid[frame], frameVpn[frame]); }
+
+    FrameList *a1in, *am;
+    PageHistory *a1out;
+};
+
+// Low Inter-reference Recency Set (Jiang and Zhang).  Most frames hold
+// LIR pages, whose last two uses were close together; the rest hold HIR
+// pages, kept in the FIFO "hirs", and are the ones replaced.  The stack
+// "recency" orders LIR pages, resident HIR pages and HIR ghosts by last
+// use; an HIR page used again while still on it becomes LIR.
+
+class LIRSPolicy : public PagePolicy {
+  public:
+    LIRSPolicy(int numFrames);
+    ~LIRSPolicy();
+
+    void Forget(int pid);
+
+  protected:
+    int Choose(int skip);
+    void Referenced(int frame);
+    void Loaded(int frame);
+    void Evicted(int frame);
+    void Freed(int frame);
+    void Renamed(int frame, int oldPid);
+
+    void Push(int pid, int vpn, int frame);	// Put a page on top of
+					// the stack
+    void MakeLIR(int frame);		// Promote a resident HIR page
+    void Prune();			// Pop HIR pages off the bottom of the stack
+    void DemoteBottom();		// Make the oldest LIR page HIR
+
+    PageHistory *recency;		// The stack, bottom (oldest) first
+    PageHistory *ghosts;		// HIR ghosts on the stack, oldest first
+    FrameList *hirs;			// Resident HIR pages
+    bool *isLIR;
+    int numLIR;
+    int maxLIR;				// Frames set aside for LIR pages
+};
+
+extern PagePolicy *NewPagePolicy(int algo, int numFrames);
+					// The policy for "rep_algo" over
+					// "numFrames" frames, NULL for the
+					// built-in ones
+
+#endif // PAGEPOLICY_H
@@ -0,0 +1,413 @@
+// pagetrace.cc
+//	Routines to record a trace of page references, and to replay it
+//	against each page replacement algorithm.  See pagetrace.h for
+//	the overall design.
+//
+//	The replay simulates nothing but the choice of frames: a whole
+//	trace is replayed for every algorithm and memory size in much
+//	less time than one run of the programs that made it.  Like the
+//	kernel, it counts a fault for the first use of every page, and a
+//	write-back for every page evicted dirty.  The trace of a single
+//	process replays to exactly the faults the kernel had; with several,
+//	a page may come back from the swap disk later than the replay
+//	assumes, while other processes run.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "pagetrace.h"
+#include "pagepolicy.h"
+
+#define REPLACE_OPT	9		// Belady's algorithm, for the replay only
+
+static char *algoNames[] = { "", "random", "FIFO", "LRU", "clock",
+			     "ARC", "CAR", "2Q", "LIRS", "OPT" };
+
+//----------------------------------------------------------------------
+// PageTrace::PageTrace
+// 	Create the trace file, and write its header.
+//
+//	"name" -- UNIX file name to hold the trace
+//----------------------------------------------------------------------
+
+PageTrace::PageTrace(char *name)
+{
+    TraceHeader header;
+
+    file = OpenForWrite(name);
+    header.magic = TraceMagic;
+    header.pageSize = PageSize;
+    header.numPhysPages = NumPhysPages;
+    WriteFile(file, (char *) &header, sizeof(header));
+    count = 0;
+    lastPid = lastVpn = -1;
+    lastWrite = FALSE;
+}
+
+//----------------------------------------------------------------------
+// PageTrace::~PageTrace
+// 	Write out the rest of the trace, and close the file.  Called when
+//	Nachos halts.
+//----------------------------------------------------------------------
+
+PageTrace::~PageTrace()
+{
+    Flush();
+    Close(file);
+}
+
+//----------------------------------------------------------------------
+// PageTrace::Append
+// 	Log a reference to page "vpn" of process "pid".  Called only when
+//	the reference tells a policy something new (see pagetrace.h).
+//----------------------------------------------------------------------
+
+void
+PageTrace::Append(int pid, int vpn, bool writing)
+{
+    lastPid = pid;
+    lastVpn = vpn;
+    lastWrite = writing;
+    Add(pid, vpn * 2 + (writing ? 1 : 0));
+}
+
+//----------------------------------------------------------------------
+// PageTrace::Release
+// 	Log that process "pid" freed all its pages, so that the replay
+//	frees them too.
+//----------------------------------------------------------------------
+
+void
+PageTrace::Release(int pid)
+{
+    lastPid = lastVpn = -1;
+    Add(pid, TraceRelease);
+}
+
+//----------------------------------------------------------------------
+// PageTrace::Add
+// 	Buffer a record, writing the buffer out when it fills.
+//----------------------------------------------------------------------
+
+void
+PageTrace::Add(int pid, int page)
+{
+    TraceRecord *record = &buffer[count++];
+
+    ASSERT((pid >= 0) && (pid < TraceRelease));
+    record->tick = stats->totalTicks;
+    record->pid = pid;
+    record->page = page;
+    if (count == TraceBufferSize)
+	Flush();
+}
+
+void
+PageTrace::Flush()
+{
+    WriteFile(file, (char *) buffer, count * sizeof(TraceRecord));
+    count = 0;
+}
+
+// The state of one replay: one algorithm with one size of memory.
+// Pages are numbered 0 to numPages-1 in the order of their first use.
+
+class TraceReplay {
+  public:
+    TraceReplay(int algo, int numFrames, int numPages);
+    ~TraceReplay();
+
+    void Reference(int page, int pid, int vpn, bool writing, int nextUse);
+					// "nextUse" is when "page" is used
+					// next, for OPT
+    void Release(int pid, int *pagePid);	// Free the pages of "pid"
+
+    int faults, writeBacks;
+
+  private:
+    int Victim();			// Choose the frame to replace
+
+    int algo, numFrames;
+    int *frameOf;			// Frame of each page, -1 if none
+    int *pageIn;			// Page in each frame, -1 if none
+    bool *dirty;			// Written since it was loaded?
+    int *nextUse;			// When the page in the frame is next
+					// used (OPT)
+    int *freeFrames, numFree;		// Frames holding no page
+    FrameList *order;			// FIFO and LRU
+    int *useBit, hand;			// Clock, as PageReplace does it
+    PagePolicy *policy;			// ARC, CAR, 2Q and LIRS
+};
+
+TraceReplay::TraceReplay(int replayAlgo, int frames, int numPages)
+{
+    int i;
+
+    algo = replayAlgo;
+    numFrames = frames;
+    faults = writeBacks = 0;
+    frameOf = new int[numPages];
+    for (i = 0; i < numPages; i++)
+	frameOf[i] = -1;
+    pageIn = new int[numFrames];
+    dirty = new bool[numFrames];
+    nextUse = new int[numFrames];
+    freeFrames = new int[numFrames];
+    useBit = new int[numFrames];
+    for (i = 0; i < numFrames; i++) {
+	pageIn[i] = -1;
+	dirty[i] = FALSE;
+	useBit[i] = 0;
+	freeFrames[i] = numFrames - 1 - i;	// hand out frame 0 first
+    }
+    numFree = numFrames;
+    hand = 0;
+    order = new FrameList(numFrames);
+    policy = NewPagePolicy(algo, numFrames);
+    if (algo == 1)
+	RandomInit(1);			// the same choices every time
+}
+
+TraceReplay::~TraceReplay()
+{
+    delete [] frameOf;
+    delete [] pageIn;
+    delete [] dirty;
+    delete [] nextUse;
+    delete [] freeFrames;
+    delete [] useBit;
+    delete order;
+    delete policy;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Victim
+// 	Choose a frame to replace, the way PageReplace does for "algo",
+//	or the frame whose page is used again furthest in the future.
+//----------------------------------------------------------------------
+
+int
+TraceReplay::Victim()
+{
+    int x = -1, i;
+
+    switch (algo) {
+      case 1:
+	x = Random() % numFrames;
+	break;
+      case 2:
+      case 3:
+	x = order->First(-1);
+	break;
+      case 4:
+	for (i = hand + 1; i <= hand + 1 + numFrames; i++) {
+	    if (useBit[i % numFrames] == 0) {
+		x = i % numFrames;
+		break;
+	    }
+	    useBit[i % numFrames] = 0;
+	}
+	hand = x;
+	break;
+      case REPLACE_OPT:
+	x = 0;
+	for (i = 1; i < numFrames; i++)
+	    if (nextUse[i] > nextUse[x])
+		x = i;
+	break;
+      default:
+	x = policy->Victim(-1);
+	policy->Evict(x);
+	break;
+    }
+    ASSERT(x >= 0);
+    return x;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Reference
+// 	Replay one reference, faulting the page in if it is not resident.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Reference(int page, int pid, int vpn, bool writing, int next)
+{
+    int frame = frameOf[page];
+
+    if (frame == -1) {
+	faults++;
+	if (numFree > 0)
+	    frame = freeFrames[--numFree];
+	else {
+	    frame = Victim();
+	    if (dirty[frame])
+		writeBacks++;
+	    frameOf[pageIn[frame]] = -1;
+	    order->Remove(frame);
+	}
+	pageIn[frame] = page;
+	frameOf[page] = frame;
+	dirty[frame] = FALSE;
+	order->Append(frame);
+	if (policy != NULL)
+	    policy->Load(frame, pid, vpn);
+    } else {
+	if (algo == 3)
+	    order->Touch(frame);
+	if (policy != NULL)
+	    policy->Reference(frame);
+    }
+    useBit[frame] = 1;
+    if (writing)
+	dirty[frame] = TRUE;
+    nextUse[frame] = next;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Release
+// 	Free the frames of process "pid", which has exited or exec'ed.
+//	"pagePid" gives the process of each page.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Release(int pid, int *pagePid)
+{
+    for (int frame = 0; frame < numFrames; frame++)
+	if ((pageIn[frame] != -1) && (pagePid[pageIn[frame]] == pid)) {
+	    frameOf[pageIn[frame]] = -1;
+	    pageIn[frame] = -1;
+	    freeFrames[numFree++] = frame;
+	    order->Remove(frame);
+	    if (policy != NULL)
+		policy->Free(frame);
+	}
+    if (policy != NULL)
+	policy->Forget(pid);
+}
+
+//----------------------------------------------------------------------
+// ReplayTrace
+// 	Read the trace in UNIX file "name", and replay it with each
+//	algorithm for 4, 8, 16, ... frames, up to the number of pages
+//	the trace uses, and for the NumPhysPages it was recorded with.
+//	Print the page faults and write-backs of each, as
+//	"faults/write-backs".
+//----------------------------------------------------------------------
+
+void
+ReplayTrace(char *name)
+{
+    TraceHeader header;
+    TraceRecord *records;
+    int fd, numRecords, numPages, numRefs, numProcs, i, algo;
+    int *pageOf, *nextUse, *pagePid, *lastUse;
+    bool *seenPid;
+    PageHistory *pages;
+    int sizes[32], numSizes, frames;
+    char cell[32];
+
+    fd = OpenForReadWrite(name, TRUE);
+    Read(fd, (char *) &header, sizeof(header));
+    ASSERT(header.magic == TraceMagic);
+    Lseek(fd, 0, 2);
+    numRecords = (Tell(fd) - sizeof(header)) / sizeof(TraceRecord);
+    Lseek(fd, sizeof(header), 0);
+    records = new TraceRecord[numRecords + 1];
+    Read(fd, (char *) records, numRecords * sizeof(TraceRecord));
+    Close(fd);
+
+    // Number the pages, and find when each reference is followed by
+    // the next one to the same page.  A page freed by a release is
+    // a new page if it is used again.
+    pages = new PageHistory(numRecords + 1);
+    pageOf = new int[numRecords + 1];
+    pagePid = new int[numRecords + 1];
+    seenPid = new bool[TraceRelease];
+    for (i = 0; i < TraceRelease; i++)
+	seenPid[i] = FALSE;
+    numPages = numRefs = numProcs = 0;
+    for (i = 0; i < numRecords; i++) {
+	int pid = records[i].pid, vpn = records[i].page / 2;
+
+	if (records[i].page == TraceRelease) {
+	    pages->Forget(pid, NULL);
+	    pageOf[i] = -1;
+	    continue;
+	}
+	numRefs++;
+	if (!pages->Contains(pid, vpn)) {
+	    pagePid[numPages] = pid;
+	    pages->Append(pid, vpn, numPages++);
+	}
+	pageOf[i] = pages->GetFrame(pid, vpn);
+	if (!seenPid[pid]) {
+	    seenPid[pid] = TRUE;
+	    numProcs++;
+	}
+    }
+    delete pages;
+    delete [] seenPid;
+    nextUse = new int[numRecords + 1];
+    lastUse = new int[numPages + 1];
+    for (i = 0; i < numPages; i++)
+	lastUse[i] = numRecords;		// never used again
+    for (i = numRecords - 1; i >= 0; i--)
+	if (pageOf[i] != -1) {
+	    nextUse[i] = lastUse[pageOf[i]];
+	    lastUse[pageOf[i]] = i;
+	}
+
+    printf("Replaying %s: %d references to %d pages by %d processes, "
+	   "over %d ticks\n", name, numRefs, numPages, numProcs,
+	   (numRecords > 0) ? (int) (records[numRecords - 1].tick
+				     - records[0].tick) : 0);
+    if (header.pageSize != PageSize)
+	printf("Warning: recorded with pages of %d bytes, not %d\n",
+	       header.pageSize, PageSize);
+
+    numSizes = 0;
+    for (frames = 4; numSizes < 30; frames *= 2) {
+	if ((header.numPhysPages < frames) && ((numSizes == 0) ||
+			(header.numPhysPages > sizes[numSizes - 1])))
+	    sizes[numSizes++] = header.numPhysPages;
+	sizes[numSizes++] = frames;
+	if (frames >= numPages)
+	    break;
+    }
+    if (sizes[numSizes - 1] < header.numPhysPages)
+	sizes[numSizes++] = header.numPhysPages;
+
+    printf("Page faults/write-backs (%d frames when recorded)\n",
+	   header.numPhysPages);
+    printf("%6s", "frames");
+    for (algo = 1; algo <= REPLACE_OPT; algo++)
+	printf("%14s", algoNames[algo]);
+    printf("\n");
+    for (int s = 0; s < numSizes; s++) {
+	printf("%6d", sizes[s]);
+	for (algo = 1; algo <= REPLACE_OPT; algo++) {
+	    TraceReplay *replay = new TraceReplay(algo, sizes[s], numPages);
+
+	    for (i = 0; i < numRecords; i++)
+		if (pageOf[i] == -1)
+		    replay->Release(records[i].pid, pagePid);
+		else
+		    replay->Reference(pageOf[i], records[i].pid,
+				      records[i].page / 2, records[i].page & 1,
+				      nextUse[i]);
+	    sprintf(cell, "%d/%d", replay->faults, replay->writeBacks);
+	    printf("%14s", cell);
+	    delete replay;
+	}
+	printf("\n");
+    }
+
+    delete [] records;
+    delete [] pageOf;
+    delete [] pagePid;
+    delete [] nextUse;
+    delete [] lastUse;
+}
@@ -0,0 +1,81 @@
+// pagetrace.h
+//	Data structures to record the page references made by user
+//	programs, and to replay them offline.
+//
+//	With -T, every reference to user memory -- instruction fetches,
+//	loads and stores, the same ones that drive LRU and clock -- is
+//	logged to a UNIX file as a (tick, pid, vpn, read/write) record.  A
+//	reference that faults is logged both times it is made, before and
+//	after the fault, just as the policies see the page loaded and then
+//	used.  A reference that cannot change what any policy does is left
+//	out: a second read, or a second write, to the page last referenced
+//	by the same process.  When a process lets go of its pages, on exit
+//	or exec, a release record is logged.
+//
+//	With -RT, Nachos reads such a trace and replays it against every
+//	replacement algorithm of -R, and Belady's optimal algorithm (OPT),
+//	for a range of memory sizes, reporting the page faults and the
+//	dirty pages written back for each.  Pages shared copy-on-write
+//	after a fork are replayed as private copies.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PAGETRACE_H
+#define PAGETRACE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define TraceMagic	0x52544750	// "PGTR", first word of a trace
+#define TraceRelease	0xffff		// "page" of a release record
+#define TraceBufferSize	1024		// Records written at a time
+
+// The first bytes of a trace file: the machine it was recorded on.
+
+class TraceHeader {
+  public:
+    int magic;				// TraceMagic
+    int pageSize;			// PageSize when recorded
+    int numPhysPages;			// NumPhysPages when recorded
+};
+
+// One reference, or a release.  Eight bytes, in host byte order.
+
+class TraceRecord {
+  public:
+    unsigned int tick;			// stats->totalTicks at the reference
+    unsigned short pid;			// Process making it
+    unsigned short page;		// Virtual page * 2, plus 1 for a write;
+					// TraceRelease for a release
+};
+
+// The following class defines a trace being recorded.
+
+class PageTrace {
+  public:
+    PageTrace(char *name);		// Start a trace in UNIX file "name"
+    ~PageTrace();			// Write out what is buffered, and close
+
+    void Reference(int pid, int vpn, bool writing)	// Log a reference
+	{ if ((pid != lastPid) || (vpn != lastVpn) || (writing && !lastWrite))
+	      Append(pid, vpn, writing); }
+    void Release(int pid);		// Log that "pid" freed its pages
+
+  private:
+    void Append(int pid, int vpn, bool writing);
+    void Add(int pid, int page);	// Buffer a record
+    void Flush();			// Write the buffered records out
+
+    int file;				// UNIX file descriptor of the trace
+    TraceRecord buffer[TraceBufferSize];
+    int count;				// Records in "buffer"
+    int lastPid, lastVpn;		// Last reference logged
+    bool lastWrite;
+};
+
+extern void ReplayTrace(char *name);	// Report faults and write-backs
+					// for the trace in UNIX file "name"
+
+#endif // PAGETRACE_H
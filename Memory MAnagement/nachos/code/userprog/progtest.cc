@@ -25,7 +25,10 @@ BatchStartFunction (int dummy)
 //----------------------------------------------------------------------
 // LaunchUserProcess
 // 	Run a user program.  Open the executable, load it into
-//	memory, and jump to it.
+//	memory, and jump to it.  A process calling Exec gives up its old
+//	image once the new one is open, before the new address space is
+//	built, as that may share its frames; if the file cannot be
+//	opened, the old image is left alone, and we return.
 //----------------------------------------------------------------------
 
 void
@@ -38,10 +41,11 @@ LaunchUserProcess(char *filename)
 	printf("Unable to open file %s\n", filename);
 	return;
     }
-    space = new ProcessAddressSpace(executable);    
-    currentThread->space = space;
-//    if (rep_algo==0)
-//	delete executable;			// close file
+    if (currentThread->space != NULL)		// Exec: the old image is gone
+	currentThread->space->Free_Exiting_Pages();
+    space = new ProcessAddressSpace(executable, filename,
+				currentThread->GetPID());	// the address
+    currentThread->space = space;		// space closes the file
 
     space->InitUserModeCPURegisters();		// set the initial register values
     space->RestoreContextOnSwitch();		// load page table register
@@ -121,6 +125,7 @@ ReadInputAndFork (char *filename)
    }
 
    //printf("%d\n", schedulingAlgo);
+   scheduler->SelectReadyQueue();
 
    if ((schedulingAlgo == ROUND_ROBIN) || (schedulingAlgo == UNIX_SCHED)) {
       ASSERT (SCHED_QUANTUM > 0);
@@ -161,8 +166,7 @@ ReadInputAndFork (char *filename)
       }
       sprintf(buffer,"Thread_%d",i+1);
       NachOSThread *child = new NachOSThread(buffer, priority[i]);
-      child->space = new ProcessAddressSpace (inFile);
-      delete inFile;
+      child->space = new ProcessAddressSpace (inFile, batchProcesses[i], child->GetPID());	// keeps inFile
       child->space->InitUserModeCPURegisters();             // set the initial register values
       child->SaveUserState ();
       child->CreateThreadStack (BatchStartFunction, 0);
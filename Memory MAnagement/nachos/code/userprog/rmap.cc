@@ -0,0 +1,156 @@
+// rmap.cc
+//	Routines to keep track of the pages that map each physical frame.
+//	See rmap.h for the overall design.
+//
+//	All of these are called with interrupts off, from the page fault
+//	handler, address space creation, or thread exit.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "rmap.h"
+#include "system.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// FrameMapping::Entry
+// 	Return the page table entry of the mapping.  It is looked up each
+//	time, as the page table may have been replaced by a bigger one.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+FrameMapping::Entry()
+{
+    return &space->GetPageTable()[vpn];
+}
+
+//----------------------------------------------------------------------
+// FrameMapping::Resident
+// 	Return the translation of the mapping, the page table entry or,
+//	under -IPT, the entry of the inverted page table; it holds the
+//	use and dirty bits of the page.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+FrameMapping::Resident()
+{
+    return space->Resident(vpn);
+}
+
+//----------------------------------------------------------------------
+// ReverseMap::ReverseMap
+// 	Initialize the map: no frame is mapped by anything.
+//----------------------------------------------------------------------
+
+ReverseMap::ReverseMap()
+{
+    for (int i = 0; i < NumPhysPages; i++) {
+	head[i] = NULL;
+	count[i] = 0;
+    }
+    freeMappings = NULL;
+}
+
+ReverseMap::~ReverseMap()
+{
+    FrameMapping *mapping;
+
+    for (int i = 0; i < NumPhysPages; i++)
+	Clear(i);
+    while (freeMappings != NULL) {
+	mapping = freeMappings;
+	freeMappings = mapping->next;
+	delete mapping;
+    }
+}
+
+//----------------------------------------------------------------------
+// ReverseMap::Add
+// 	Note that page "vpn" of "space", of process "pid", maps "frame".
+//	The mapping goes at the end of the list, so that the owner stays
+//	the owner.
+//----------------------------------------------------------------------
+
+void
+ReverseMap::Add(int frame, int pid, ProcessAddressSpace *space, int vpn)
+{
+    FrameMapping *mapping, **link;
+
+    if (freeMappings != NULL) {
+	mapping = freeMappings;
+	freeMappings = mapping->next;
+    } else
+	mapping = new FrameMapping;
+    mapping->pid = pid;
+    mapping->space = space;
+    mapping->vpn = vpn;
+    mapping->next = NULL;
+    for (link = &head[frame]; *link != NULL; link = &(*link)->next)
+	;
+    *link = mapping;
+    count[frame]++;
+}
+
+//----------------------------------------------------------------------
+// ReverseMap::Remove
+// 	Page "vpn" of "space" no longer maps "frame".  It must have.
+//----------------------------------------------------------------------
+
+void
+ReverseMap::Remove(int frame, ProcessAddressSpace *space, int vpn)
+{
+    FrameMapping *mapping, **link;
+
+    for (link = &head[frame]; *link != NULL; link = &(*link)->next)
+	if (((*link)->space == space) && ((*link)->vpn == vpn))
+	    break;
+    ASSERT(*link != NULL);
+    mapping = *link;
+    *link = mapping->next;
+    mapping->next = freeMappings;
+    freeMappings = mapping;
+    count[frame]--;
+}
+
+//----------------------------------------------------------------------
+// ReverseMap::Clear
+// 	Drop every mapping of "frame".
+//----------------------------------------------------------------------
+
+void
+ReverseMap::Clear(int frame)
+{
+    FrameMapping *mapping;
+
+    while (head[frame] != NULL) {
+	mapping = head[frame];
+	head[frame] = mapping->next;
+	mapping->next = freeMappings;
+	freeMappings = mapping;
+    }
+    count[frame] = 0;
+}
+
+//----------------------------------------------------------------------
+// ReverseMap::FindShared
+// 	Return the frame into which a process has faulted the page of
+//	shared memory kept in swap slot "slot", or -1 if none has.  Every
+//	process mapping the page has the same slot, so the owner will do.
+//----------------------------------------------------------------------
+
+int
+ReverseMap::FindShared(int slot)
+{
+    TranslationEntry *entry;
+
+    for (int frame = 0; frame < NumPhysPages; frame++) {
+	if (head[frame] == NULL)
+	    continue;
+	entry = head[frame]->Entry();
+	if (entry->shared && (entry->swapSlot == slot))
+	    return frame;
+    }
+    return -1;
+}
@@ -0,0 +1,85 @@
+// rmap.h
+//	Data structures for the reverse map: for each physical frame, the
+//	pages of the processes that map it.
+//
+//	A frame can be mapped by several processes at once: a page shared
+//	copy-on-write after a fork, a code page shared by the processes
+//	running one executable, or a page of shared memory (ShmAllocate),
+//	which the children of the process inherit.  To replace such a
+//	frame, every mapping of it has to be found, and taken away at the
+//	same time.
+//
+//	A mapping is noted as the address space and the virtual page that
+//	map the frame, rather than as a pointer to the page table entry,
+//	so that it stays good when a page table grows (see ShmAllocate).
+//	The first mapping of a frame is its owner: the page replacement
+//	policies know the frame by the pid and page number of the owner.
+//
+//	A page of shared memory that has been saved to the swap area keeps
+//	its slot, with a reference from every process sharing it, until
+//	they are all done with it.  The processes fault the page back in
+//	one at a time; the first reads it from the slot, and the others
+//	find the frame it went to by the slot (FindShared).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef RMAP_H
+#define RMAP_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "machine.h"
+
+class ProcessAddressSpace;
+
+// One process's mapping of a frame.
+
+class FrameMapping {
+  public:
+    TranslationEntry *Entry();		// The page table entry of the mapping
+    TranslationEntry *Resident();	// Its translation to the frame, which
+					// is in the inverted page table under
+					// -IPT
+
+    int pid;				// The process
+    ProcessAddressSpace *space;		// Its address space
+    int vpn;				// The page of it that maps the frame
+    FrameMapping *next;			// The next mapping of the same frame
+};
+
+// The following class defines the reverse map of physical memory.
+
+class ReverseMap {
+  public:
+    ReverseMap();			// No frame is mapped
+    ~ReverseMap();
+
+    void Add(int frame, int pid, ProcessAddressSpace *space, int vpn);
+					// Page "vpn" of "space" now maps
+					// "frame"; the first one to do so
+					// owns it
+    void Remove(int frame, ProcessAddressSpace *space, int vpn);
+					// It no longer does; the next
+					// mapping, if any, becomes the owner
+    void Clear(int frame);		// Nothing maps "frame" any more
+
+    FrameMapping *Mappings(int frame) { return head[frame]; }	// Owner
+					// first, NULL if there are none
+    int Count(int frame) { return count[frame]; }
+    int Owner(int frame)		// Pid of the owner, -1 if none
+	{ return (head[frame] != NULL) ? head[frame]->pid : -1; }
+    TranslationEntry *OwnerEntry(int frame)	// NULL if none
+	{ return (head[frame] != NULL) ? head[frame]->Entry() : NULL; }
+    int FindShared(int slot);		// Frame holding the page of shared
+					// memory saved in swap slot "slot",
+					// -1 if it is not in memory
+
+  private:
+    FrameMapping *head[NumPhysPages];	// Mappings of each frame
+    int count[NumPhysPages];		// How many there are
+    FrameMapping *freeMappings;		// Unused ones, kept for reuse
+};
+
+#endif // RMAP_H
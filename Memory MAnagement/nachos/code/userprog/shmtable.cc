@@ -0,0 +1,160 @@
+// shmtable.cc
+//	Routines to keep track of named segments of shared memory, and of
+//	the processes that have them attached.  See shmtable.h for the
+//	overall design; the pages themselves are mapped and unmapped in
+//	addrspace.cc.
+//
+//	All of these are called with interrupts off, from the system
+//	calls, fork, or thread exit.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "shmtable.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// ShmSegment::ShmSegment
+// 	Initialize a segment of "numPages" pages named "key".  Nobody has
+//	it attached, and its pages have never been used.
+//----------------------------------------------------------------------
+
+ShmSegment::ShmSegment(int segmentKey, int pages)
+{
+    key = segmentKey;
+    numPages = pages;
+    slot = new int[pages];
+    for (int i = 0; i < pages; i++)
+	slot[i] = -1;
+    attached = NULL;
+}
+
+ShmSegment::~ShmSegment()
+{
+    ShmAttachment *attachment;
+
+    while (attached != NULL) {
+	attachment = attached;
+	attached = attachment->next;
+	delete attachment;
+    }
+    delete [] slot;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::ShmTable
+// 	Initialize the table: there are no segments.
+//----------------------------------------------------------------------
+
+ShmTable::ShmTable()
+{
+    for (int id = 0; id < MaxShmSegments; id++)
+	segment[id] = NULL;
+}
+
+ShmTable::~ShmTable()
+{
+    for (int id = 0; id < MaxShmSegments; id++)
+	delete segment[id];
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Get
+// 	Return the id of the segment named "key", making one of
+//	"numPages" pages if there is none.  A process asking for more
+//	pages than the segment has gets -1, as does one asking for a new
+//	segment when there is no room for it.
+//----------------------------------------------------------------------
+
+int
+ShmTable::Get(int key, int numPages)
+{
+    int id, unused = -1;
+
+    for (id = 0; id < MaxShmSegments; id++) {
+	if (segment[id] == NULL) {
+	    if (unused < 0)
+		unused = id;
+	} else if (segment[id]->key == key)
+	    return (numPages <= segment[id]->numPages) ? id : -1;
+    }
+    if ((unused < 0) || (numPages <= 0))
+	return -1;
+    segment[unused] = new ShmSegment(key, numPages);
+    DEBUG('t', "Made shared memory segment %d, key %d, %d pages\n",
+		unused, key, numPages);
+    return unused;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Segment
+// 	Return segment "id", or NULL if there is no such segment.
+//----------------------------------------------------------------------
+
+ShmSegment *
+ShmTable::Segment(int id)
+{
+    if ((id < 0) || (id >= MaxShmSegments))
+	return NULL;
+    return segment[id];
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Attach
+// 	Note that "space" has segment "id" attached, from page "base" on.
+//----------------------------------------------------------------------
+
+void
+ShmTable::Attach(int id, ProcessAddressSpace *space, int base)
+{
+    ShmAttachment *attachment = new ShmAttachment;
+
+    ASSERT(segment[id] != NULL);
+    attachment->space = space;
+    attachment->base = base;
+    attachment->next = segment[id]->attached;
+    segment[id]->attached = attachment;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Detach
+// 	"space" no longer has segment "id" at page "base".  It must have.
+//----------------------------------------------------------------------
+
+void
+ShmTable::Detach(int id, ProcessAddressSpace *space, int base)
+{
+    ShmAttachment *attachment, **link;
+
+    for (link = &segment[id]->attached; *link != NULL; link = &(*link)->next)
+	if (((*link)->space == space) && ((*link)->base == base))
+	    break;
+    ASSERT(*link != NULL);
+    attachment = *link;
+    *link = attachment->next;
+    delete attachment;
+}
+
+//----------------------------------------------------------------------
+// ShmTable::Find
+// 	Return the id of the segment "space" has attached at page "base",
+//	or -1 if it has none there.
+//----------------------------------------------------------------------
+
+int
+ShmTable::Find(ProcessAddressSpace *space, int base)
+{
+    ShmAttachment *attachment;
+
+    for (int id = 0; id < MaxShmSegments; id++) {
+	if (segment[id] == NULL)
+	    continue;
+	for (attachment = segment[id]->attached; attachment != NULL;
+			attachment = attachment->next)
+	    if ((attachment->space == space) && (attachment->base == base))
+		return id;
+    }
+    return -1;
+}
@@ -0,0 +1,86 @@
+// shmtable.h
+//	Data structures for named segments of shared memory.
+//
+//	ShmAllocate gives a process shared memory that only its children
+//	see, as they inherit it at the fork.  A segment, by contrast, is
+//	named by a key: any process can look it up (ShmGet) and attach it
+//	to its address space (ShmAt), and unrelated processes, such as
+//	those of one batch, share it that way.  A process detaches a
+//	segment with ShmDt, or when it exits; its children inherit the
+//	segments it has attached.
+//
+//	The pages of a segment are pages of shared memory like any other,
+//	and are replaced the same way (see UnmapFrame in addrspace.cc).
+//	A process attaching a segment maps them the way a process that
+//	has it attached already does, as a child does at a fork.  When the
+//	last process detaches it, the pages are saved to the swap area,
+//	and the segment keeps their slots for the next process to attach
+//	it.  A segment that was never attached has no pages yet; they are
+//	zeroed on the first attach.  Segments last until Nachos halts.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SHMTABLE_H
+#define SHMTABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define MaxShmSegments	32	// Most segments there can be
+
+class ProcessAddressSpace;
+
+// One process's attachment of a segment.
+
+class ShmAttachment {
+  public:
+    ProcessAddressSpace *space;		// The process
+    int base;				// Its first page of the segment
+    ShmAttachment *next;		// The next process attached to it
+};
+
+// A segment.
+
+class ShmSegment {
+  public:
+    ShmSegment(int key, int numPages);	// Nobody has it attached
+    ~ShmSegment();
+
+    int key;				// What the processes call it
+    int numPages;			// How big it is
+    int *slot;				// Swap slots its pages are in while
+					// nobody has it attached; -1 for
+					// a page never used
+    ShmAttachment *attached;		// The processes that have it attached
+};
+
+// The following class defines the table of segments.
+
+class ShmTable {
+  public:
+    ShmTable();				// There are no segments
+    ~ShmTable();
+
+    int Get(int key, int numPages);	// Id of the segment named "key",
+					// made "numPages" long if there is
+					// none; -1 if it is shorter, or the
+					// table is full
+    ShmSegment *Segment(int id);	// NULL if there is no such segment
+    ShmAttachment *Attachments(int id) { return segment[id]->attached; }
+					// Most recent first
+    void Attach(int id, ProcessAddressSpace *space, int base);
+					// "space" has segment "id" at page
+					// "base" now
+    void Detach(int id, ProcessAddressSpace *space, int base);
+					// It no longer has
+    int Find(ProcessAddressSpace *space, int base);	// Id of the
+					// segment "space" has at page "base",
+					// -1 if none
+
+  private:
+    ShmSegment *segment[MaxShmSegments];	// NULL for an unused id
+};
+
+#endif // SHMTABLE_H
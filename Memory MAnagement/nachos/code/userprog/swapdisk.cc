@@ -0,0 +1,269 @@
+// swapdisk.cc
+//	Routines to keep evicted pages on a simulated swap disk.
+//	See swapdisk.h for the overall design.
+//
+//	All of these are called with interrupts off, from the page fault
+//	handler or from thread exit, except RequestDone, which runs as
+//	an interrupt handler.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "swapdisk.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// SwapRequestDone
+// 	Disk interrupt handler.  Need this to be a C routine, because
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+SwapRequestDone (int arg)
+{
+    SwapDisk* swap = (SwapDisk *)arg;
+
+    swap->RequestDone();
+}
+
+//----------------------------------------------------------------------
+// SwapRequest::SwapRequest
+// 	Set up a request for "slot".  A write takes a copy of "data", so
+//	that the caller can reuse it before the disk gets to the request.
+//----------------------------------------------------------------------
+
+SwapRequest::SwapRequest(int slotNumber, char *buffer, bool isWrite)
+{
+    slot = slotNumber;
+    writing = isWrite;
+    if (writing) {
+	data = new char[SectorSize];
+	bcopy(buffer, data, SectorSize);
+	done = NULL;
+    } else {
+	data = buffer;
+	done = new Semaphore("swap read", 0);
+    }
+}
+
+SwapRequest::~SwapRequest()
+{
+    if (writing)
+	delete [] data;
+    else
+	delete done;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::SwapDisk
+// 	Initialize the swap area.  Every slot starts out free; whatever
+//	an earlier run left on the disk is never read.
+//
+//	"name" -- UNIX file name to be used as storage for the disk data
+//----------------------------------------------------------------------
+
+SwapDisk::SwapDisk(char* name)
+{
+    ASSERT(PageSize == SectorSize);	// a page fits exactly in a slot
+    disk = new Disk(name, SwapRequestDone, (int) this);
+    freeSlots = new BitMap(NumSectors);
+    for (int i = 0; i < NumSectors; i++) {
+	refCount[i] = 0;
+	held[i] = NULL;
+    }
+    active = NULL;
+    waiting = new List;
+    writeBehind = FALSE;
+    numHeld = nextHeld = 0;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::~SwapDisk
+// 	De-allocate the swap area.
+//----------------------------------------------------------------------
+
+SwapDisk::~SwapDisk()
+{
+    for (int i = 0; i < NumSectors; i++)
+	delete held[i];
+    delete disk;
+    delete freeSlots;
+    delete waiting;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::AllocateSlot
+// 	Find a free slot for a page.  Returns -1 if there is none.
+//----------------------------------------------------------------------
+
+int
+SwapDisk::AllocateSlot()
+{
+    int slot = freeSlots->Find();
+
+    if (slot >= 0)
+	refCount[slot] = 1;
+    DEBUG('a', "Allocated swap slot %d\n", slot);
+    return slot;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::ShareSlot/ReleaseSlot
+// 	Another page table entry starts or stops using "slot".  A slot
+//	is only rewritten in place by its last user.  A write held back
+//	for a slot nobody uses any more is dropped.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::ShareSlot(int slot)
+{
+    ASSERT(refCount[slot] > 0);
+    refCount[slot]++;
+}
+
+void
+SwapDisk::ReleaseSlot(int slot)
+{
+    ASSERT(refCount[slot] > 0);
+    if (--refCount[slot] == 0) {
+	freeSlots->Clear(slot);
+	if (held[slot] != NULL) {
+	    delete held[slot];
+	    held[slot] = NULL;
+	    numHeld--;
+	}
+	DEBUG('a', "Freed swap slot %d\n", slot);
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::ReadPage
+// 	Read the page in "slot" into "data".  The calling thread sleeps
+//	until the disk has served every request queued before this one,
+//	and then this one -- unless a write to the slot is held back, in
+//	which case the page is copied from it.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::ReadPage(int slot, char *data)
+{
+    SwapRequest *request;
+
+    ASSERT(refCount[slot] > 0);
+    if (held[slot] != NULL) {
+	bcopy(held[slot]->data, data, SectorSize);
+	return;
+    }
+    request = new SwapRequest(slot, data, FALSE);
+    Queue(request);
+    request->done->P();
+    delete request;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::WritePage
+// 	Write the page in "data" to "slot".  Returns at once: the disk
+//	writes a copy of the page when it gets to the request.  With
+//	write-behind on, the copy is held back, replacing any older one
+//	for the slot.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::WritePage(int slot, char *data)
+{
+    ASSERT(refCount[slot] > 0);
+    if (!writeBehind) {
+	Queue(new SwapRequest(slot, data, TRUE));
+	return;
+    }
+    if (held[slot] != NULL)
+	bcopy(data, held[slot]->data, SectorSize);
+    else {
+	held[slot] = new SwapRequest(slot, data, TRUE);
+	numHeld++;
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Flush
+// 	If the disk is idle, start writing one of the pages held back.
+//	They go out in slot order, from where the last one was, which
+//	keeps the seeks short.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::Flush()
+{
+    int slot;
+
+    if ((active != NULL) || (numHeld == 0))
+	return;
+    for (slot = nextHeld; held[slot] == NULL; slot = (slot + 1) % NumSectors)
+	;
+    nextHeld = (slot + 1) % NumSectors;
+    Start(held[slot]);
+    held[slot] = NULL;
+    numHeld--;
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Queue
+// 	Send "request" to the disk if it is idle; otherwise it waits for
+//	the requests ahead of it.  Since requests are served in order, a
+//	read always sees the last write queued to the slot.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::Queue(SwapRequest *request)
+{
+    ASSERT(interrupt->getLevel() == IntOff);
+    if (active == NULL)
+	Start(request);
+    else
+	waiting->Append((void *)request);
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::Start
+// 	Hand "request" to the raw disk, which charges it the seek,
+//	rotational delay and transfer time from Disk::ComputeLatency.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::Start(SwapRequest *request)
+{
+    active = request;
+    DEBUG('a', "%s swap slot %d\n", request->writing ? "Writing" : "Reading",
+							request->slot);
+    if (request->writing)
+	disk->WriteRequest(request->slot, request->data);
+    else
+	disk->ReadRequest(request->slot, request->data);
+}
+
+//----------------------------------------------------------------------
+// SwapDisk::RequestDone
+// 	The disk has finished the active request.  Wake up its reader,
+//	if any, and start the next request; a write held back only goes
+//	when no read is waiting.
+//----------------------------------------------------------------------
+
+void
+SwapDisk::RequestDone()
+{
+    SwapRequest *request = active;
+
+    ASSERT(request != NULL);
+    active = NULL;
+    if (request->writing)
+	delete request;
+    else
+	request->done->V();		// the reader deletes it
+
+    if (!waiting->IsEmpty())
+	Start((SwapRequest *)waiting->Remove());
+    else
+	Flush();
+}
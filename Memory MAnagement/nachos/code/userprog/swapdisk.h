@@ -0,0 +1,91 @@
+// swapdisk.h
+//	Data structures for the swap area: a simulated disk, separate
+//	from the one the file system uses, that holds the pages evicted
+//	from main memory.
+//
+//	Each page is kept in one sector of the disk (a "slot").  Slots
+//	are reference counted, so that a forked child can share the
+//	swapped pages of its parent instead of copying them.
+//
+//	The raw disk takes one request at a time, so requests are queued
+//	and sent to it in the order they are made.  A write copies the
+//	page when it is queued, letting the caller reuse the frame at
+//	once; a read waits until the disk has delivered the page.
+//
+//	With write-behind on (for the page cleaner, -PC), writes are held
+//	back, at most one per slot, and only sent to the disk when no
+//	read is waiting; a read of a slot with a write held back is
+//	served from the copy.  A page fault then waits for its own read,
+//	never for the write-back of the page it replaced.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAPDISK_H
+#define SWAPDISK_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "bitmap.h"
+#include "list.h"
+#include "synch.h"
+
+// One read or write of a slot, waiting for or being served by the disk.
+
+class SwapRequest {
+  public:
+    SwapRequest(int slot, char *data, bool writing);
+    ~SwapRequest();
+
+    int slot;			// Sector to read or write
+    char *data;			// Page contents; our own copy for a write
+    bool writing;
+    Semaphore *done;		// A reader waits on this; NULL for a write
+};
+
+// The following class defines the swap area.
+
+class SwapDisk {
+  public:
+    SwapDisk(char* name);		// Initialize the swap area, on the
+					// simulated disk kept in UNIX file "name"
+    ~SwapDisk();
+
+    int AllocateSlot();			// Find a free slot, with one reference
+					// to it; -1 if the swap area is full
+    void ShareSlot(int slot);		// Add a reference to "slot"
+    void ReleaseSlot(int slot);		// Drop a reference; the slot is free
+					// once there are none left
+    bool IsShared(int slot) { return refCount[slot] > 1; }
+
+    void ReadPage(int slot, char *data);	// Read "slot" into "data",
+					// waiting for the disk to get to it
+    void WritePage(int slot, char *data);	// Queue a write of "data" to
+					// "slot", and return right away
+    void SetWriteBehind() { writeBehind = TRUE; }	// Hold writes
+					// back until the disk is idle
+    void Flush();			// Start a write held back, if the
+					// disk is idle
+    bool Busy() { return (active != NULL) || (numHeld > 0); }
+					// Is there anything for the disk to do?
+
+    void RequestDone();			// Called by the disk interrupt handler
+
+  private:
+    void Queue(SwapRequest *request);	// Send "request" to the disk, or
+					// queue it if the disk is busy
+    void Start(SwapRequest *request);	// Send "request" to the disk
+
+    Disk *disk;				// Raw disk device
+    BitMap *freeSlots;			// Slots in use
+    int refCount[NumSectors];		// Page table entries using each slot
+    SwapRequest *active;		// Request the disk is serving
+    List *waiting;			// Requests queued behind it
+    bool writeBehind;			// Are writes held back?
+    SwapRequest *held[NumSectors];	// The write held back for each slot
+    int numHeld;
+    int nextHeld;			// Where to look for the next one
+};
+
+#endif // SWAPDISK_H
@@ -49,6 +49,9 @@
 #define SysCall_CondOp		25
 #define SysCall_CondRemove	26
 #define SysCall_ShmAllocate	27
+#define SysCall_ShmGet		28
+#define SysCall_ShmAt		29
+#define SysCall_ShmDt		30
 #define SysCall_NumInstr        50
 
 #ifndef IN_ASM
@@ -180,6 +183,23 @@ int syscall_wrapper_CondRemove (int condid);
 
 unsigned syscall_wrapper_ShmAllocate (unsigned size);
 
+/* Return the id of the segment of shared memory named "key", making one
+ * of "size" bytes if there is none; -1 if it is smaller than that, or
+ * there is no room for another.  Unrelated processes share memory by
+ * attaching the segment of the same key.
+ */
+int syscall_wrapper_ShmGet (int key, unsigned size);
+
+/* Attach segment "id" to the address space; return its address, or -1
+ * if there is no such segment.  Children inherit it at a fork.
+ */
+unsigned syscall_wrapper_ShmAt (int id);
+
+/* Detach the segment attached at "addr"; return 0, or -1 if there is
+ * none there.  It is detached at exit (and exec) too.
+ */
+int syscall_wrapper_ShmDt (unsigned addr);
+
 int syscall_wrapper_GetNumInstr (void);
 #endif /* IN_ASM */
 
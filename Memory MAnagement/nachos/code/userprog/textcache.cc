@@ -0,0 +1,124 @@
+// textcache.cc
+//	Routines to share code pages among processes running the same
+//	executable.  See textcache.h for the overall design.
+//
+//	All of these are called with interrupts off, from the page fault
+//	handler, address space creation, or thread exit.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "textcache.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// TextCache::TextCache
+// 	Initialize an empty cache: no frame holds a shared code page.
+//----------------------------------------------------------------------
+
+TextCache::TextCache()
+{
+    int i;
+
+    numNames = 0;
+    for (i = 0; i < NumPhysPages; i++) {
+	fileOf[i] = vpnOf[i] = chain[i] = -1;
+    }
+    for (i = 0; i < TextBuckets; i++)
+	bucket[i] = -1;
+}
+
+TextCache::~TextCache()
+{
+    for (int i = 0; i < numNames; i++)
+	delete [] names[i];
+}
+
+//----------------------------------------------------------------------
+// TextCache::FileNumber
+// 	Return the index of executable "name" in the table of names.  If
+//	it is not there, and "add" is TRUE, add it, unless the table is
+//	full.  Returns -1 if "name" is not (and cannot be) in the table.
+//----------------------------------------------------------------------
+
+int
+TextCache::FileNumber(char *name, bool add)
+{
+    int i;
+
+    for (i = 0; i < numNames; i++)
+	if (!strcmp(names[i], name))
+	    return i;
+    if (!add || (numNames == MaxTextFiles))
+	return -1;
+    names[numNames] = new char[strlen(name) + 1];
+    strcpy(names[numNames], name);
+    return numNames++;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Lookup
+// 	Return the frame holding page "vpn" of executable "name", or -1
+//	if it is not in memory.
+//----------------------------------------------------------------------
+
+int
+TextCache::Lookup(char *name, int vpn)
+{
+    int file = FileNumber(name, FALSE);
+    int frame;
+
+    if (file == -1)
+	return -1;
+    for (frame = bucket[Bucket(file, vpn)]; frame != -1; frame = chain[frame])
+	if ((fileOf[frame] == file) && (vpnOf[frame] == vpn))
+	    return frame;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Insert
+// 	Enter "frame", just read in, as holding page "vpn" of executable
+//	"name".  If there is no room for the name, the page is simply not
+//	shared.
+//----------------------------------------------------------------------
+
+void
+TextCache::Insert(char *name, int vpn, int frame)
+{
+    int file = FileNumber(name, TRUE);
+    int b;
+
+    if (file == -1)
+	return;
+    ASSERT(fileOf[frame] == -1);
+    ASSERT(Lookup(name, vpn) == -1);
+    b = Bucket(file, vpn);
+    fileOf[frame] = file;
+    vpnOf[frame] = vpn;
+    chain[frame] = bucket[b];
+    bucket[b] = frame;
+    DEBUG('a', "Code page %d of %s cached in frame %d\n", vpn, name, frame);
+}
+
+//----------------------------------------------------------------------
+// TextCache::Remove
+// 	Take "frame" out of the cache, because it is being replaced or
+//	freed, or its only user is about to write to it.
+//----------------------------------------------------------------------
+
+void
+TextCache::Remove(int frame)
+{
+    int *link;
+
+    if (fileOf[frame] == -1)
+	return;
+    for (link = &bucket[Bucket(fileOf[frame], vpnOf[frame])]; *link != frame;
+							link = &chain[*link])
+	;
+    *link = chain[frame];
+    fileOf[frame] = vpnOf[frame] = chain[frame] = -1;
+}
@@ -0,0 +1,65 @@
+// textcache.h
+//	Data structures to share the code pages of an executable among
+//	all the processes running it.
+//
+//	A page that lies wholly inside the code segment is the same in
+//	every process running the executable, and is never written.  The
+//	first process to fault on such a page reads it in as usual, and
+//	enters its frame here under the executable's name and the page
+//	number.  A process running the same executable later maps the
+//	frame instead of reading the page again: at once, if the page is
+//	already in memory when its address space is created, or when it
+//	faults on it otherwise.
+//
+//	A shared code page is mapped read-only and copy-on-write, like a
+//	page shared after a fork, so that replacing it, or the exit of
+//	the process that loaded it, is handled the same way.  A frame
+//	leaves the cache when it is replaced, freed, or written to by the
+//	last process mapping it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "machine.h"
+
+#define MaxTextFiles	64		// Executables that can have pages
+					// in the cache
+#define TextBuckets	64		// Size of the hash table
+
+// The following class defines the cache of code pages.
+
+class TextCache {
+  public:
+    TextCache();			// Initialize an empty cache
+    ~TextCache();
+
+    int Lookup(char *name, int vpn);	// Frame holding page "vpn" of the
+					// executable "name", or -1 if none
+    void Insert(char *name, int vpn, int frame);	// "frame" now holds
+					// page "vpn" of "name"
+    void Remove(int frame);		// "frame" no longer holds a code page
+					// that can be shared; does nothing if
+					// it is not in the cache
+
+  private:
+    int FileNumber(char *name, bool add);	// Index of "name" in
+					// "names"; -1 if it is not there
+					// (and cannot be added)
+    int Bucket(int file, int vpn) { return (file * 31 + vpn) % TextBuckets; }
+
+    char *names[MaxTextFiles];		// Executables seen so far
+    int numNames;
+    int fileOf[NumPhysPages];		// Executable of the page in each
+					// frame, -1 if the frame is not cached
+    int vpnOf[NumPhysPages];		// Page number of the page in it
+    int chain[NumPhysPages];		// Next frame in the same bucket
+    int bucket[TextBuckets];		// First frame in each bucket
+};
+
+#endif // TEXTCACHE_H
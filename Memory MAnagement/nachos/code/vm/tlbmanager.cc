@@ -0,0 +1,186 @@
+// tlbmanager.cc
+//	Routines to refill the software-managed TLB on a miss, and to
+//	keep it consistent with the page tables.  See tlbmanager.h for
+//	the overall design.
+//
+//	All of these are called with interrupts off, from the exception
+//	handler, a context switch, or the routines that change a mapping.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "tlbmanager.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// TLBManager::TLBManager
+// 	Start out with an empty TLB, and no ASID handed out.
+//
+//	"replacement" -- TLB_RANDOM, TLB_FIFO or TLB_LRU
+//----------------------------------------------------------------------
+
+TLBManager::TLBManager(int replacement)
+{
+    ASSERT((replacement >= TLB_RANDOM) && (replacement <= TLB_LRU));
+    policy = replacement;
+    loadedAt = new unsigned[machine->tlbSize];
+    for (int i = 0; i < machine->tlbSize; i++)
+	loadedAt[i] = 0;
+    refills = 0;
+    lastRefill = -1;
+    nextASID = 0;
+    generation = 1;
+    Flush();
+}
+
+TLBManager::~TLBManager()
+{
+    delete [] loadedAt;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Refill
+// 	Handle a miss on "vaddr": copy the page table entry of the
+//	current process into the TLB, tagged with its ASID.
+//
+//	Returns NoException if the page is in memory (the instruction can
+//	simply be retried), PageFaultException if it has to be brought in
+//	first, and AddressErrorException if it is not in the address space.
+//----------------------------------------------------------------------
+
+ExceptionType
+TLBManager::Refill(int vaddr)
+{
+    unsigned vpn = (unsigned) vaddr / PageSize;
+    TranslationEntry *entry;
+    int slot;
+
+    stats->numTLBMisses++;
+    if (vpn >= machine->KernelPageTableSize)
+	return AddressErrorException;
+    entry = &machine->KernelPageTable[vpn];
+    if (entry->unmapped)
+	return AddressErrorException;
+    if (!entry->valid)
+	return PageFaultException;
+    slot = Victim(vpn % (machine->tlbSize / machine->tlbWays));
+    machine->tlb[slot] = *entry;
+    machine->tlb[slot].asid = machine->tlbASID;
+    loadedAt[slot] = ++refills;
+    lastRefill = slot;
+    DEBUG('a', "TLB entry %d: vpn %d, frame %d, asid %d\n", slot, vpn,
+		entry->physicalPage, machine->tlbASID);
+    return NoException;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Victim
+// 	Choose the entry of "set" to refill: an empty one if there is
+//	one, and otherwise one picked by the replacement policy.
+//
+//	The entry refilled last is never picked.  One instruction can
+//	miss twice, on its own page and on the data it loads or stores;
+//	if the second refill threw out the first, it would miss forever.
+//----------------------------------------------------------------------
+
+int
+TLBManager::Victim(int set)
+{
+    int first = set * machine->tlbWays, last = first + machine->tlbWays;
+    int i, victim = -1;
+    bool keep = (lastRefill >= first) && (lastRefill < last);
+
+    for (i = first; i < last; i++)
+	if (!machine->tlb[i].valid)
+	    return i;
+    switch (policy) {
+      case TLB_RANDOM:
+	victim = first + Random() % (machine->tlbWays - (keep ? 1 : 0));
+	if (keep && (victim >= lastRefill))
+	    victim++;
+	break;
+      case TLB_FIFO:
+	for (i = first; i < last; i++)
+	    if ((i != lastRefill) && 
+			((victim < 0) || (loadedAt[i] < loadedAt[victim])))
+		victim = i;
+	break;
+      case TLB_LRU:
+	for (i = first; i < last; i++)
+	    if ((i != lastRefill) && ((victim < 0) || 
+			(machine->tlbLastUse[i] < machine->tlbLastUse[victim])))
+		victim = i;
+	break;
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::SwitchTo
+// 	An address space is about to run.  Load its ASID into the
+//	machine; if it has none from the current generation, hand it the
+//	next one, flushing the TLB first if they have all been used.
+//
+//	"asid", "generation" -- kept in the address space
+//----------------------------------------------------------------------
+
+void
+TLBManager::SwitchTo(int *asid, unsigned *asidGeneration)
+{
+    if (*asidGeneration != generation) {
+	if (nextASID == NumASIDs) {
+	    Flush();
+	    stats->numTLBFlushes++;
+	    generation++;
+	    nextASID = 0;
+	}
+	*asid = nextASID++;
+	*asidGeneration = generation;
+    }
+    machine->tlbASID = *asid;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::InvalidatePage
+// 	The current process's mapping of page "vpn" is changing; drop
+//	its TLB entry, so the next reference refills it.
+//----------------------------------------------------------------------
+
+void
+TLBManager::InvalidatePage(int vpn)
+{
+    int first = (vpn % (machine->tlbSize / machine->tlbWays)) * machine->tlbWays;
+
+    for (int i = first; i < first + machine->tlbWays; i++)
+	if (machine->tlb[i].valid && (machine->tlb[i].virtualPage == vpn)
+			&& (machine->tlb[i].asid == machine->tlbASID))
+	    machine->tlb[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::InvalidateFrame
+// 	"frame" is being taken away from whatever maps it; drop every
+//	TLB entry for it, of any process.
+//----------------------------------------------------------------------
+
+void
+TLBManager::InvalidateFrame(int frame)
+{
+    for (int i = 0; i < machine->tlbSize; i++)
+	if (machine->tlb[i].valid && (machine->tlb[i].physicalPage == frame))
+	    machine->tlb[i].valid = FALSE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Flush
+// 	Empty the TLB.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Flush()
+{
+    for (int i = 0; i < machine->tlbSize; i++)
+	machine->tlb[i].valid = FALSE;
+}
@@ -0,0 +1,76 @@
+// tlbmanager.h
+//	Data structures for the kernel side of the software-managed TLB,
+//	in the virtual memory build (USE_TLB).
+//
+//	The machine translates through the TLB only.  On a miss it raises
+//	a page fault, and the kernel refills the TLB from the page table
+//	of the current process; only if the page table has no valid entry
+//	either is it a real page fault.  The TLB is set associative: a
+//	page can only go in the ways of the set its number maps to, and
+//	the kernel chooses which of them to replace at random, first in
+//	first out, or least recently used (-TR).
+//
+//	Entries are tagged with an address space identifier (ASID), so a
+//	context switch does not flush the TLB.  A process is given an
+//	ASID the first time it runs, and keeps it until NumASIDs have
+//	been handed out; then the TLB is flushed, and each process gets
+//	a new one when it next runs.
+//
+//	The kernel must drop the TLB entries for a page whenever it
+//	changes the mapping: when the page is replaced, copied on a
+//	write, or made read-only by a fork.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TLBMANAGER_H
+#define TLBMANAGER_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "machine.h"
+
+#define NumASIDs	64		// Address space identifiers the TLB
+					// can tell apart
+
+// Values of -TR, numbered like the page replacement algorithms (-R)
+
+#define TLB_RANDOM	1
+#define TLB_FIFO	2
+#define TLB_LRU		3
+
+// The following class defines the TLB miss handler, and the rest of
+// what the kernel does to keep the TLB consistent.
+
+class TLBManager {
+  public:
+    TLBManager(int replacement);	// Manage the machine's TLB, replacing
+					// entries as "replacement" says
+    ~TLBManager();
+
+    ExceptionType Refill(int vaddr);	// Load the translation of "vaddr";
+					// PageFaultException if the page is
+					// not in memory
+    void SwitchTo(int *asid, unsigned *generation);	// Run with the
+					// ASID of an address space, giving
+					// it a new one if it has none
+    void InvalidatePage(int vpn);	// Drop the entry for page "vpn" of
+					// the current process
+    void InvalidateFrame(int frame);	// Drop every entry mapping "frame"
+    void Flush();			// Drop every entry
+
+  private:
+    int Victim(int set);		// Entry of "set" to refill
+
+    int policy;				// TLB_RANDOM, TLB_FIFO or TLB_LRU
+    unsigned *loadedAt;			// When each entry was refilled
+    unsigned refills;			// Refills so far
+    int lastRefill;			// The entry of the last one
+    int nextASID;			// Next ASID to hand out
+    unsigned generation;		// Number of times they ran out, plus
+					// one; an ASID from an older
+					// generation is no longer good
+};
+
+#endif // TLBMANAGER_H